@@ -0,0 +1,272 @@
+/*
+ * dmbench - measure how fast dm dumps.
+ *
+ * Generates some synthetic inputs (random bytes, zeros, ASCII text,
+ * UTF-8 text and a sparse file), then dumps each of them with each
+ * of a set of representative formats, writing the dump to /dev/null.
+ * Each run is repeated and the best time is kept.
+ * The results are written as tab separated lines, one per run:
+ *   input  options  bytes  seconds  MB/s  lines/s
+ * so they can be compared from one build to the next.
+ *
+ * usage: dmbench [-s MB] [-r repeats] [-o file] [-d dir] [dm]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "dm.h"
+
+/*
+ * Option sets to dump with.  Options are separated by spaces.
+ */
+static char *formats[] = {
+	"-xb +c",
+	"-xlz",
+	"-dL",
+	"-Cemo",
+	"-u",
+	"-xbz +c -ow -dl",
+	"-xb +u -J4",
+	NULL
+};
+
+static char *inputs[] = { "random", "zero", "text", "utf8", "sparse", NULL };
+
+static u64 rng = 0x9E3779B97F4A7C15ULL;
+
+/*
+ * A small, fast pseudo-random generator (xorshift),
+ * so the inputs are the same every time.
+ */
+	static u64
+rand64(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	return (rng);
+}
+
+	static void
+fail(char *msg, char *arg)
+{
+	fprintf(stderr, "dmbench: %s %s\n", msg, (arg != NULL) ? arg : "");
+	exit(1);
+}
+
+/*
+ * Fill buf with one block of an input of the given kind.
+ */
+	static void
+genblock(char *kind, u8 *buf, size_t len)
+{
+	static char *words[] = {
+		"the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+		"dump", "file", "format", "byte", "0x7f", "{", "}", ";", NULL };
+	static char *uwords[] = {
+		"caf\xc3\xa9", "\xce\xb1\xce\xb2\xce\xb3", "\xe6\x97\xa5\xe6\x9c\xac",
+		"\xd0\xbc\xd0\xb8\xd1\x80", "na\xc3\xafve", "\xf0\x9f\x98\x80",
+		"\xe2\x82\xac", "abc", NULL };
+	size_t i = 0;
+
+	if (strcmp(kind, "zero") == 0) {
+		memset(buf, 0, len);
+		return;
+	}
+	if (strcmp(kind, "random") == 0) {
+		for (;  i + 8 <= len;  i += 8) {
+			u64 r = rand64();
+			memcpy(buf + i, &r, 8);
+		}
+		for (;  i < len;  i++)
+			buf[i] = (u8) rand64();
+		return;
+	}
+	/* Text: words separated by spaces, with a newline now and then. */
+	while (i < len) {
+		char **w = (strcmp(kind, "utf8") == 0) ? uwords : words;
+		int nw = 0;
+		char *s;
+		while (w[nw] != NULL)
+			nw++;
+		s = w[rand64() % nw];
+		while (*s != '\0' && i < len)
+			buf[i++] = *s++;
+		if (i < len)
+			buf[i++] = (rand64() % 10 == 0) ? '\n' : ' ';
+	}
+}
+
+/*
+ * Create an input file of size bytes.
+ * The sparse file is mostly holes, with a block of data every so often.
+ */
+	static void
+geninput(char *kind, char *path, off_t size)
+{
+	size_t blen = 1024*1024;
+	u8 *buf;
+	off_t pos;
+	int fd;
+
+	if ((fd = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0666)) < 0)
+		fail("cannot create", path);
+	if ((buf = (u8 *) malloc(blen)) == NULL)
+		fail("cannot allocate buffer", NULL);
+	for (pos = 0;  pos < size;  pos += blen) {
+		size_t n = (size - pos < (off_t) blen) ? (size_t) (size - pos) : blen;
+		if (strcmp(kind, "sparse") == 0) {
+			/* One block in 16 has data. */
+			if ((pos / blen) % 16 != 0)
+				continue;
+			genblock("random", buf, n);
+		} else {
+			genblock(kind, buf, n);
+		}
+		if (pwrite(fd, buf, n, pos) != (ssize_t) n)
+			fail("cannot write", path);
+	}
+	if (ftruncate(fd, size) < 0)
+		fail("cannot set size of", path);
+	free(buf);
+	close(fd);
+}
+
+	static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+/*
+ * Run dm with the options in opts on a file, with the output
+ * going to /dev/null.  Returns the time it took, or -1 if it failed.
+ */
+	static double
+rundm(char *dm, char *opts, char *path)
+{
+	char *argv[32];
+	char *copy = strdup(opts);
+	char *w;
+	int argc = 0;
+	double start;
+	pid_t pid;
+	int status;
+
+	argv[argc++] = dm;
+	for (w = strtok(copy, " ");  w != NULL && argc < 30;  w = strtok(NULL, " "))
+		argv[argc++] = w;
+	argv[argc++] = path;
+	argv[argc] = NULL;
+	start = now();
+	if ((pid = fork()) < 0)
+		fail("cannot fork", NULL);
+	if (pid == 0) {
+		int fd = open("/dev/null", O_WRONLY);
+		dup2(fd, 1);
+		execv(dm, argv);
+		_exit(127);
+	}
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		free(copy);
+		return (-1);
+	}
+	free(copy);
+	return (now() - start);
+}
+
+/*
+ * Number of bytes per line for a set of options.
+ */
+	static int
+linesize(char *opts)
+{
+	char *n = strstr(opts, "-n");
+	return ((n != NULL) ? atoi(n+2) : 16);
+}
+
+	int
+main(int argc, char *argv[])
+{
+	char *dm = "./dm";
+	char *outname = "bench.out";
+	char *dir = NULL;
+	char tmpl[] = "/tmp/dmbenchXXXXXX";
+	off_t size = 64;
+	int repeats = 3;
+	FILE *out;
+	int ix, fx, c;
+
+	while ((c = getopt(argc, argv, "s:r:o:d:")) != -1) {
+		switch (c)
+		{
+		case 's': size = atol(optarg); break;
+		case 'r': repeats = atoi(optarg); break;
+		case 'o': outname = optarg; break;
+		case 'd': dir = optarg; break;
+		default:
+			fprintf(stderr, "usage: dmbench [-s MB] [-r repeats] [-o file] [-d dir] [dm]\n");
+			exit(1);
+		}
+	}
+	if (optind < argc)
+		dm = argv[optind];
+	if (size < 1 || repeats < 1)
+		fail("bad size or repeat count", NULL);
+	size *= 1024*1024;
+	if (dir == NULL && (dir = mkdtemp(tmpl)) == NULL)
+		fail("cannot create directory", tmpl);
+	if ((out = fopen(outname, "w")) == NULL)
+		fail("cannot create", outname);
+	fprintf(out, "# input\toptions\tbytes\tseconds\tMB/s\tlines/s\n");
+
+	for (ix = 0;  inputs[ix] != NULL;  ix++) {
+		char path[1024];
+		off_t isize = size;
+		if (strcmp(inputs[ix], "sparse") == 0)
+			/* Mostly holes, so make it bigger. */
+			isize *= 16;
+		snprintf(path, sizeof(path), "%s/%s", dir, inputs[ix]);
+		geninput(inputs[ix], path, isize);
+		for (fx = 0;  formats[fx] != NULL;  fx++) {
+			double best = -1;
+			int r;
+			for (r = 0;  r < repeats;  r++) {
+				double t = rundm(dm, formats[fx], path);
+				if (t < 0) {
+					best = -1;
+					break;
+				}
+				if (best < 0 || t < best)
+					best = t;
+			}
+			if (best < 0) {
+				fprintf(stderr, "dmbench: %s %s %s failed\n", dm, formats[fx], path);
+				continue;
+			}
+			if (best < 1e-6)
+				best = 1e-6;
+			fprintf(out, "%s\t%s\t%lld\t%.3f\t%.1f\t%.0f\n",
+				inputs[ix], formats[fx], (long long) isize, best,
+				isize / best / (1024*1024),
+				(isize + linesize(formats[fx]) - 1) / linesize(formats[fx]) / best);
+			printf("%-7s %-20s %8.1f MB/s\n", inputs[ix], formats[fx],
+				isize / best / (1024*1024));
+			fflush(stdout);
+		}
+		unlink(path);
+	}
+	fclose(out);
+	if (dir == tmpl)
+		rmdir(dir);
+	return (0);
+}
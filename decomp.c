@@ -0,0 +1,257 @@
+/*
+ * Decompress compressed input as it is read.
+ *
+ * A file compressed with gzip, zstd or xz is recognized by the
+ * magic bytes at its start.  Its data is piped through the
+ * decompressor program, and dm reads the decompressor's output
+ * instead of the file, so addresses are offsets in the uncompressed
+ * data, and nothing is written to disk.  The output is a pipe, so
+ * skipping ahead (-f) decompresses the data and throws it away,
+ * without printing it.
+ * A file which can seek is given to the decompressor directly.
+ * The start of anything else has been read already (to look at
+ * its magic bytes), so a child process writes those bytes to the
+ * decompressor, followed by the rest of the input.
+ * If the decompressor fails before it writes anything, the magic
+ * bytes were a coincidence; a file which can seek is then dumped
+ * as it is.  (Input which can't seek has been passed on to the
+ * decompressor, so it cannot be dumped.)
+ */
+
+#define _GNU_SOURCE /* for pipe2 */
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "dm.h"
+
+int decompress = 1;   /* Decompress compressed input (no -Z) */
+
+struct decomp
+{
+	u8 magic[MAGICLEN]; /* First bytes of a compressed file */
+	int len;            /* Number of bytes in magic */
+	char *argv[4];      /* Command to decompress the standard input */
+};
+
+#define NDECOMP  (sizeof(decomps) / sizeof(decomps[0]))
+
+static struct decomp decomps[] = {
+	/* gzip, with the deflate method (the only one defined). */
+	{ { 0x1f, 0x8b, 0x08 }, 3, { "gzip", "-dc", NULL } },
+	{ { 0x28, 0xb5, 0x2f, 0xfd }, 4, { "zstd", "-dcq", NULL } },
+	/* xz can decompress in several threads. */
+	{ { 0xfd, '7', 'z', 'X', 'Z', 0x00 }, 6, { "xz", "-dc", "-T0", NULL } },
+};
+
+/*
+ * Write n bytes, retrying if interrupted.
+ * Returns -1 if they cannot all be written.
+ */
+	static int
+writeall(int fd, u8 *buf, size_t n)
+{
+	while (n > 0) {
+		ssize_t w = write(fd, buf, n);
+		if (w < 0 && errno == EINTR)
+			continue;
+		if (w <= 0)
+			return (-1);
+		buf += w;
+		n -= w;
+	}
+	return (0);
+}
+
+/*
+ * In a child process: write the start of the input, which has
+ * already been read, and then copy the rest of it, to fd.
+ * The child does not exec, so close-on-exec does not help it;
+ * it closes everything else it inherited (except stderr), so that
+ * it does not hold open the pipes of other inputs being read
+ * at the same time (-J), which would keep them from seeing EOF.
+ */
+	static void
+feed(int fd, int infd, u8 *head, size_t n)
+{
+	u8 buf[64*1024];
+	ssize_t r;
+	long maxfd = sysconf(_SC_OPEN_MAX);
+	int i;
+
+	if (maxfd < 0)
+		maxfd = 1024;
+	for (i = 0;  i < maxfd;  i++)
+		if (i != fd && i != infd && i != 2)
+			close(i);
+	if (writeall(fd, head, n) < 0)
+		_exit(1);
+	for (;;) {
+		r = read(infd, buf, sizeof(buf));
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0 || writeall(fd, buf, (size_t) r) < 0)
+			break;
+	}
+	_exit(0);
+}
+
+/*
+ * Wait until the decompressor writes something, or finishes
+ * without writing anything.
+ * Returns 0 if it has written something, or succeeded with no output,
+ * and -1 if it failed first.
+ */
+	static int
+started(struct input *in, int fd)
+{
+	struct pollfd p;
+	int status;
+	int n;
+
+	p.fd = fd;
+	p.events = POLLIN;
+	for (;;) {
+		if (poll(&p, 1, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			return (0);
+		}
+		if (ioctl(fd, FIONREAD, &n) < 0 || n > 0 || !(p.revents & POLLHUP))
+			return (0);
+		break;
+	}
+	/* The output was closed before any was written. */
+	while (waitpid(in->pid, &status, 0) < 0)
+		if (errno != EINTR)
+			return (0);
+	in->pid = 0;
+	return ((WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : -1);
+}
+
+/*
+ * Stop the process feeding the decompressor.
+ */
+	static void
+endfeeder(struct input *in)
+{
+	int status;
+
+	if (in->feeder > 0) {
+		kill(in->feeder, SIGTERM);
+		waitpid(in->feeder, &status, 0);
+		in->feeder = 0;
+	}
+}
+
+/*
+ * If the input is compressed, start a decompressor, and read its
+ * output instead of the input.
+ * head is the first n bytes of the input.  If the input can't seek,
+ * they have already been read from it, and must be fed to the
+ * decompressor before the rest.
+ * Returns 1 if the input is now the output of a decompressor,
+ * 0 if it is not compressed, or -1 on error.
+ */
+	int
+in_decompress(struct input *in, u8 *head, size_t n)
+{
+	struct decomp *d;
+	int out[2];
+	int src[2];
+
+	if (!decompress)
+		return (0);
+	for (d = decomps;  d < decomps + NDECOMP;  d++)
+		if (n >= d->len && eqbuf(head, d->magic, d->len))
+			break;
+	if (d >= decomps + NDECOMP)
+		return (0);
+
+	if (pipe2(out, O_CLOEXEC) < 0) {
+		fprintf(stderr, "cannot create pipe for %s\n", in->name);
+		return (-1);
+	}
+	src[0] = in->fd;
+	src[1] = -1;
+	if (in->base < 0) {
+		/*
+		 * The start of the input has been read;
+		 * a feeder process passes it on, with the rest.
+		 */
+		if (pipe2(src, O_CLOEXEC) < 0) {
+			fprintf(stderr, "cannot create pipe for %s\n", in->name);
+			close(out[0]);
+			close(out[1]);
+			return (-1);
+		}
+		if ((in->feeder = fork()) < 0)
+			panic("cannot fork");
+		if (in->feeder == 0)
+			feed(src[1], in->fd, head, n);
+		close(src[1]);
+	}
+	if ((in->pid = fork()) < 0)
+		panic("cannot fork");
+	if (in->pid == 0) {
+		/*
+		 * The decompressor reads the file from where we started,
+		 * and writes to the pipe.
+		 */
+		if (dup2(src[0], 0) < 0 || dup2(out[1], 1) < 0)
+			_exit(127);
+		execvp(d->argv[0], d->argv);
+		fprintf(stderr, "dm: cannot run %s to decompress %s\n", d->argv[0], in->name);
+		_exit(127);
+	}
+	close(out[1]);
+	if (src[0] != in->fd)
+		close(src[0]);
+	if (started(in, out[0]) < 0) {
+		close(out[0]);
+		endfeeder(in);
+		if (in->base >= 0) {
+			fprintf(stderr, "dm: dumping %s without decompressing it\n", in->name);
+			return (0);
+		}
+		fprintf(stderr, "dm: %s could not decompress %s\n", d->argv[0], in->name);
+		return (-1);
+	}
+	if (in->fd != 0)
+		close(in->fd);
+	in->fd = out[0];
+	in->base = -1;
+	in->decomp = d->argv[0];
+	return (1);
+}
+
+/*
+ * Wait for the decompressor to finish, after its output is closed.
+ * Returns -1 if it failed.  If we did not read all its output,
+ * it is expected to fail, when it can't write the rest.
+ */
+	int
+in_endecompress(struct input *in)
+{
+	int status;
+	int ret = 0;
+
+	endfeeder(in);
+	if (in->pid <= 0)
+		/* It finished before writing anything. */
+		return (0);
+	while (waitpid(in->pid, &status, 0) < 0)
+		if (errno != EINTR)
+			return (-1);
+	if (in->eof && WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+		if (WEXITSTATUS(status) != 127)
+			/* (It failed to run if 127, and said so.) */
+			fprintf(stderr, "dm: %s could not decompress %s\n", in->decomp, in->name);
+		ret = -1;
+	}
+	return (ret);
+}
@@ -0,0 +1,204 @@
+/*
+ * Diff mode: compare two files, and dump only the lines which differ.
+ *
+ * The files are read side by side, a large block at a time.
+ * Runs of identical lines are passed over with a block compare
+ * and never printed.  Each line which differs is dumped from both
+ * files, one after the other, in all the formats, followed by a
+ * line of markers under the items which changed.
+ * Both files are read into fixed size buffers (never mapped),
+ * so the memory used does not depend on the size of the files.
+ */
+
+#include "dm.h"
+
+extern struct dmctx *dm;
+
+/*
+ * Amount of each file to compare at once,
+ * unless a line (and its lookahead) is bigger.
+ */
+#define DIFFBLOCK  (INBUFSIZE/2)
+
+/*
+ * Amount to compare with one memcmp while looking for a difference.
+ */
+#define DIFFSTEP   4096
+
+#define MARKCH     '^'
+
+static char *marks;       /* The marker line being built */
+static u8 *changed;       /* Which bytes of the line differ */
+
+/*
+ * Return the number of bytes at the start of a and b (up to n)
+ * which are the same.
+ */
+	static size_t
+samelen(u8 *a, u8 *b, size_t n)
+{
+	size_t i = 0;
+
+	while (i + DIFFSTEP <= n && eqbuf(a + i, b + i, DIFFSTEP))
+		i += DIFFSTEP;
+	while (i < n && a[i] == b[i])
+		i++;
+	return (i);
+}
+
+/*
+ * Allocate the marker line: wide enough for every format,
+ * whichever line it is on.
+ */
+	static void
+setmarks(void)
+{
+	size_t len = dm->aformat.width + strlen(dm->aformat.after) + 2;
+	int fx;
+
+	for (fx = 0;  fx < dm->nformat;  fx++) {
+		struct format *f = &dm->format[fx];
+		len += dm->count * (f->width + strlen(f->inter)) + strlen(f->after);
+	}
+	marks = (char *) malloc(len);
+	changed = (u8 *) malloc(dm->count);
+	if (marks == NULL || changed == NULL)
+		panic("cannot allocate marker line");
+}
+
+/*
+ * Print a line of markers under each item with a changed byte,
+ * for each line of formats.
+ */
+	static void
+prmarks(void)
+{
+	int indent = dm->aformat.width + strlen(dm->aformat.after);
+	int col = (dm->aformat.flags & NOPRINT) ? 0 : indent;
+	int fx;
+
+	memset(marks, ' ', col);
+	for (fx = 0;  fx < dm->nformat;  fx++) {
+		struct format *f = &dm->format[fx];
+		int psize = (f->size > 0) ? f->size : 1;
+		int interlen = strlen(f->inter);
+		int i;
+
+		if (!(f->flags & NOPRINT)) {
+			for (i = 0;  i < dm->count;  i += psize) {
+				int end = (i + psize < dm->count) ? i + psize : dm->count;
+				int mark = ' ';
+				int k;
+				for (k = i;  k < end;  k++)
+					if (changed[k])
+						mark = MARKCH;
+				if (i > 0) {
+					memset(marks + col, ' ', interlen);
+					col += interlen;
+				}
+				memset(marks + col, mark, f->width);
+				col += f->width;
+			}
+		}
+		if (fx+1 < dm->nformat && dm->format[fx+1].col > 0) {
+			/* The next format is on the same line. */
+			if (!(f->flags & NOPRINT)) {
+				memset(marks + col, ' ', strlen(f->after));
+				col += strlen(f->after);
+			}
+			continue;
+		}
+		/* End of a line of formats. */
+		while (col > 0 && marks[col-1] == ' ')
+			col--;
+		marks[col++] = '\n';
+		prbytes(marks, col);
+		memset(marks, ' ', indent);
+		col = indent;
+	}
+	if (dm->group_line)
+		prstring("\n");
+	prendline();
+}
+
+/*
+ * Print the line at addr from both files, and mark the differences.
+ * len1 and len2 are the bytes available from each file.
+ */
+	static void
+prdiff(off_t addr, u8 *data1, size_t len1, u8 *data2, size_t len2)
+{
+	struct dumpstate st;
+	size_t l1 = (len1 < (size_t) dm->count) ? len1 : dm->count;
+	size_t l2 = (len2 < (size_t) dm->count) ? len2 : dm->count;
+	int i;
+
+	for (i = 0;  i < dm->count;  i++)
+		changed[i] = (i < l1) != (i < l2) ||
+			(i < l1 && data1[i] != data2[i]);
+	/* Never collapse a line into a "*". */
+	st.firstaddr = addr;
+	st.last_len = 0;
+	st.didstar = 0;
+	dumpline(dm, &st, addr, data1, len1);
+	dumpline(dm, &st, addr, data2, len2);
+	prmarks();
+}
+
+/*
+ * Compare two files and dump the lines which differ.
+ * Returns 0 if the files are the same, 1 if they differ,
+ * or -1 if they cannot be read.
+ */
+	int
+difffiles(char *name1, char *name2)
+{
+	struct input in1, in2;
+	off_t addr = 0;
+	int differ = 0;
+	size_t block = DIFFBLOCK;
+
+	if (block < dm->count + LOOKAHEAD)
+		block = dm->count + LOOKAHEAD;
+	/* Keeping a line of history makes the buffers big enough for a block. */
+	if (in_open(&in1, name1, dm->count, 0) < 0)
+		return (-1);
+	if (in_open(&in2, name2, dm->count, 0) < 0) {
+		in_close(&in1);
+		return (-1);
+	}
+	if (marks == NULL)
+		setmarks();
+	for (;;) {
+		size_t n1 = in_fill(&in1, block);
+		size_t n2 = in_fill(&in2, block);
+		size_t n = (n1 < n2) ? n1 : n2;
+		size_t skip;
+
+		if (n1 == 0 && n2 == 0)
+			break;
+		/* Pass over the whole lines which are the same. */
+		skip = samelen(in1.data, in2.data, n);
+		skip -= skip % dm->count;
+		if (skip == 0) {
+			/* This line differs, unless it is the same short last line. */
+			size_t l1 = (n1 < (size_t) dm->count) ? n1 : dm->count;
+			size_t l2 = (n2 < (size_t) dm->count) ? n2 : dm->count;
+			if (l1 != l2 || !eqbuf(in1.data, in2.data, l1)) {
+				prdiff(addr, in1.data, n1, in2.data, n2);
+				differ = 1;
+			}
+			skip = dm->count;
+		}
+		in_advance(&in1, skip);
+		in_advance(&in2, skip);
+		addr += skip;
+	}
+	/* Print the final address. */
+	printbuf(&dm->aformat, (u8*) &addr, sizeof(addr), sizeof(addr), sizeof(addr));
+	prstring("\n");
+	prendline();
+	in_close(&in1);
+	in_close(&in2);
+	return (differ);
+}
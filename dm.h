@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include "libdm.h"
 
 #define version "1.3"
 
@@ -23,14 +24,42 @@ typedef unsigned long long u64;
 #define UTF_CONTIN  -2
 
 /*
- * Max number of formats.
+ * Unicode character properties, from utf8_props().
  */
-#define NFORMAT		 16
+#define UP_PRINT    (1<<0)  /* Printable */
+#define UP_WIDE     (1<<1)  /* Double width */
+#define UP_COMPOSE  (1<<2)  /* Combining mark (Mn, Me) */
+#define UP_FMT      (1<<3)  /* Format control (Cf) */
+#define UP_BIN      (1<<4)  /* Control, surrogate, private use (Cc Cs Co Zl Zp) */
+#define UP_COMB     (1<<5)  /* Combines with a following character */
 
 /*
- * Max bytes per input line.
+ * Number of bytes past the end of a line which may be examined
+ * while printing it: an item which straddles the end of the line,
+ * or a UTF-8 sequence which starts near the end of the line.
  */
-#define	MAXLINESIZE	 128
+#define	LOOKAHEAD	 8
+
+/*
+ * Max length of a search pattern.
+ */
+#define	MAXPATTERN	 4096
+
+/*
+ * Number of bytes at the start of a file which show
+ * whether (and how) it is compressed.
+ */
+#define	MAGICLEN	 6
+
+/*
+ * Size of the buffer used to read input which is not mapped.
+ */
+#define	INBUFSIZE	 (1024*1024)
+
+/*
+ * Size of the output buffer.
+ */
+#define	OUTBUFSIZE	 (256*1024)
 
 #ifndef NULL
 #define	NULL		0
@@ -43,11 +72,39 @@ typedef unsigned long long u64;
  */
 #define	eqbuf(b1,b2,len)	(memcmp((b1),(b2),(len)) == 0)
 
+typedef union {
+	s64 s;
+	u64 u;
+} number;
+
+/*
+ * Converts a block of VECBLOCK bytes to digits.
+ */
+#define VECBLOCK 16
+typedef void (*blockfn)(u8 *in, char *out, u8 *perm, char *digitch);
+
+/*
+ * How to print the digits of a number.
+ */
+struct numfmt
+{
+	int radix;     /* Radix (base) of number representation */
+	int comma;     /* Spacing of commas within printed number */
+	char commach;  /* Character to use as a comma */
+	char *digitch; /* Characters to use as digits */
+	int minwidth;  /* Minimum number of digits (zero padding) */
+	char *(*conv)(struct numfmt *nf, u64 unum, char *end);
+	               /* Converts a number to digits */
+	char *convname;/* Name of conv */
+	int shift;     /* log2 of radix (rounded up) */
+	u64 magic;     /* Multiplicative inverse of radix */
+};
+
 struct format
 {
 	char *after;   /* String to print after all the numbers in a line */
 	char *inter;   /* String to print between numbers in a line */
-	short flags;   /* Flags: see below */
+	int flags;     /* Flags: see below */
 	int radix;     /* Radix (base) of number representation
 	                  Note: radix 1 means character printing */
 	int size;      /* Size of numbers (1=byte, 2=word, 4=long) */
@@ -56,6 +113,178 @@ struct format
 	int comma;     /* Spacing of commas within printed number */
 	int col;       /* Column of this format; formats that are 
 	                  directly under each other have the same column */
+	struct format *fields; /* Fields of a record format */
+	int nfields;   /* Number of fields */
+	int offset;    /* Offset of a field in its record */
+
+	/*
+	 * The render plan, set up by setplan() once all options
+	 * have been processed.
+	 */
+	void (*line)(struct format *f, u8 *buf, ssize_t size, ssize_t len, ssize_t rlen);
+	               /* Print one line of data */
+	u64 (*get)(u8 *buf);
+	               /* Extract one item from the data */
+	char *(*item)(struct format *f, number num, char *buf, int *widthp);
+	               /* Return the printable form of one item */
+	void (*just)(struct format *f, char *s, int width);
+	               /* Print one item, padded to the width */
+	int (*printable)(unsigned long ch);
+	               /* Is a character printable? */
+	char **cstyle; /* C style escapes, or NULL */
+	char **mnemonic; /* ASCII mnemonics, or NULL */
+	struct numfmt num;  /* How to print numbers */
+	struct numfmt cnum; /* How to print characters as numbers */
+	char *table;   /* Rendered items for byte (or word) formats */
+	int cellsize;  /* Size of each entry in table */
+	blockfn block; /* Converts a block of hex or binary items */
+	u8 perm[VECBLOCK]; /* Order in which to convert the bytes of a block */
+	char plan[64]; /* Description of the plan */
+};
+
+/*
+ * An input file.
+ */
+struct input
+{
+	char *name;    /* Name of the file, for messages */
+	int fd;
+	u8 *map;       /* Mapped file contents, or NULL if not mapped */
+	size_t mapsize;/* Size of the mapping */
+	u8 *data;      /* Next unconsumed byte of input */
+	size_t len;    /* Number of bytes available at data */
+	off_t addr;    /* File address of data */
+	off_t end;     /* File address of the end of the range, or -1 */
+	off_t base;    /* File offset of address 0, or -1 if we can't seek */
+	int wfd;       /* inotify descriptor to wait for the file to grow */
+	size_t hist;   /* Number of bytes before data to preserve */
+	int eof;       /* No more data beyond data+len */
+	u8 *rbuf;      /* Read buffer, if not mapped */
+	size_t rsize;  /* Size of rbuf */
+	pid_t pid;     /* Decompressor we read from, or 0 */
+	pid_t feeder;  /* Process feeding the decompressor, or 0 */
+	char *decomp;  /* Name of the decompressor */
+};
+
+/*
+ * A buffer of output.
+ */
+struct outbuf
+{
+	char *buf;
+	size_t len;    /* Number of bytes in buf */
+	size_t size;   /* Allocated size of buf */
+	int fd;        /* File to write to when full, or -1 to grow instead,
+	                  or OUTFIXED if it must not grow */
+	int tty;       /* fd is a terminal */
+	u8 *line;      /* Copy of a line being printed, near the end of the data */
+	size_t linesize; /* Allocated size of line */
+	int full;      /* An OUTFIXED buffer ran out of room */
+};
+
+#define OUTFIXED (-2)
+
+/*
+ * Output modes (-T).
+ */
+#define OUT_TEXT  0  /* Formatted text */
+#define OUT_JSON  1  /* JSON Lines */
+#define OUT_CSV   2  /* Comma separated values */
+#define OUT_BIN   3  /* Packed binary records */
+
+/*
+ * One column of machine readable output: an item of a format.
+ */
+struct column
+{
+	int fx;        /* Index of the format in format[] */
+	int item;      /* Number of the item in the format */
+	int offset;    /* Offset of the item in the line */
+	int size;      /* Size of the item in the data */
+	int kind;      /* What the value is: see below */
+	u64 (*get)(u8 *buf);
+	               /* Extract the item from the data */
+};
+
+#define COL_UNSIGNED 0 /* Unsigned integer */
+#define COL_SIGNED   1 /* Signed integer */
+#define COL_CHAR     2 /* Character code */
+#define COL_UTF8     3 /* Unicode codepoint, or -1 if none starts here */
+
+/*
+ * A dump context: the formats, and the options which control
+ * how each line is printed.  Set up by dm_parse() and dm_ready(),
+ * then only read while dumping, so several threads may share one.
+ */
+struct dmctx
+{
+	struct format *format;/* All data formats */
+	int nformat;          /* Number of formats in format[] */
+	int maxformat;        /* Allocated size of format[] */
+	struct format aformat;/* Address format */
+	struct format def;    /* Defaults for unspecified attributes of a format */
+	int count;            /* Count of bytes per line */
+	int countset;         /* -n was given */
+	int verbose;          /* Show all data */
+	int color;            /* Color the output */
+	int group_line;       /* Extra newline after each line group */
+	int ready;            /* dm_ready() has been called */
+	int bigendian;        /* This machine is big-endian */
+	int mode;             /* Output mode (OUT_*) */
+	struct column *columns; /* Columns of machine readable output */
+	int ncolumns;         /* Number of columns */
+	int recsize;          /* Size of a binary record */
+	char *addrtab;        /* "after" string of the last format in a line */
+	char error[128];      /* Message for the last error */
+};
+
+/*
+ * A range of a file to dump.
+ */
+struct range
+{
+	off_t start;   /* Offset to start dumping; negative counts from the end */
+	off_t length;  /* Amount to dump, or -1 */
+	off_t end;     /* Offset to stop dumping, or -1 */
+};
+
+/*
+ * A file to dump, as part of a batch.
+ */
+struct dumpjob
+{
+	char *name;
+	struct range *ranges; /* Parts of the file to dump */
+	int nranges;
+};
+
+/*
+ * State carried from one line of a dump to the next.
+ */
+struct dumpstate
+{
+	off_t firstaddr; /* Address of the first line */
+	size_t last_len; /* Length of the last line printed */
+	int didstar;     /* Already printed "*" for these duplicate lines */
+};
+
+/*
+ * Counts and times for --stats, kept by each thread.
+ */
+struct stats
+{
+	off_t bytesread;   /* Bytes read from input files */
+	off_t bytesmapped; /* Bytes of input files mapped */
+	off_t bytesdumped; /* Bytes in lines printed or collapsed */
+	off_t lines;       /* Lines printed */
+	off_t starred;     /* Lines collapsed into "*" */
+	off_t discarded;   /* Bytes read and thrown away to skip them */
+	off_t holebytes;   /* Bytes in holes skipped without reading */
+	double tread;      /* Time reading input */
+	double twrite;     /* Time writing output */
+	double taddr;      /* Time printing addresses */
+	double *tformat;   /* Time printing each format */
+	int nformat;       /* Number of formats in tformat */
 };
 
 /* Flags */
@@ -72,19 +301,67 @@ struct format
 #define DM_LITTLE_ENDIAN (1<< 10) /* Little-endian */
 #define UTF_8            (1<< 11) /* UTF-8 chars */
 #define DM_CODEPT        (1<< 12) /* UTF-8 codepoints */
+#define WTABLE           (1<< 13) /* Use a table for word items */
+#define RECORD           (1<< 14) /* A record of fields */
+#define COLOR            (1<< 15) /* Color the output */
 
-void dumpfile(char *filename);
+int undumpfile(char *filename);
+int difffiles(char *name1, char *name2);
+int dumpfile(char *filename, struct range *ranges, int nranges, int threads);
+int dumpfiles(struct dumpjob *jobs, long n, int nthreads, char *outdir);
+off_t getoffset(char **ss);
+struct range *getranges(char **ss, int *np);
+struct range *parseranges(char **ss, int *np, char **errp);
+void dumpline(struct dmctx *c, struct dumpstate *st, off_t addr, u8 *data, size_t avail);
+void markline(struct dmctx *c, off_t addr, u8 *data, size_t avail, u8 *mark);
+size_t searchhist(void);
+void searchrange(struct input *in);
+off_t dumpchunks(u8 *data, size_t len, off_t addr, int nthreads);
 int ndigits(int radix, int size);
-void option(char *s);
+int gdigit(int ch);
+int getnum(char **ss, off_t *np);
 int options(int argc, char *argv[]);
 void panic(char *s);
 void printbuf(struct format *f, u8 *buf, ssize_t size, ssize_t len, ssize_t rlen);
+void prmarked(struct format *f, u8 *buf, ssize_t size, ssize_t len, ssize_t rlen, u8 *mark);
 void prstring(char *s);
+void prbytes(char *s, size_t n);
+void prflush(void);
+struct outbuf *prsetout(struct outbuf *ob);
+u8 *prlinebuf(size_t n);
+void proutbuf(struct outbuf *ob);
+void prendline(void);
 void usage(char *s);
 int defwidth(int radix, int size, int comma);
+size_t itemmax(struct format *f);
+void setplan(struct format *f);
+blockfn vec_block(int radix, char **namep);
+size_t ascii_span(u8 *buf, size_t n);
+u8 *findpat(u8 *buf, size_t n, u8 *pat, size_t plen);
+int in_open(struct input *in, char *filename, size_t hist, int canmap);
+int in_seek(struct input *in, off_t offset, off_t length, int byread);
+off_t in_size(struct input *in);
+size_t in_fill(struct input *in, size_t need);
+void in_advance(struct input *in, size_t n);
+int in_hole(struct input *in, off_t pos, off_t *startp, off_t *endp);
+void in_skiphole(struct input *in, off_t n);
+int in_wait(struct input *in);
+int in_close(struct input *in);
+int setcolumns(struct dmctx *c);
+size_t machheadmax(struct dmctx *c);
+void machheader(struct dmctx *c);
+void machline(struct dmctx *c, off_t addr, u8 *line, size_t line_len, size_t avail);
+int in_decompress(struct input *in, u8 *head, size_t n);
+int in_endecompress(struct input *in);
+void stat_start(struct dmctx *c);
+void stat_merge(void);
+void stat_grow(int nformat);
+double stat_now(void);
+void stat_progress(struct input *in, off_t addr, int done);
 int utf8_size(u8 ch);
 int utf8_is_contin(u8 ch);
 int utf8_value(u8 *buf, int *plen);
+int utf8_props(unsigned long ch);
 int utf8_is_wide(unsigned long ch);
 int utf8_is_printable(unsigned long ch);
 void utf8_encode(int value, u8 *buf, int *plen);
@@ -0,0 +1,807 @@
+/*
+ * Parse format specifications into a dump context.
+ *
+ * Each specification is one of dm's format options, such as "-xb",
+ * "+c" or "--d", or one of the options which control the layout of
+ * lines (-n, -v, -E).  Errors are returned to the caller, with
+ * a message in the context, rather than reported here.
+ */
+
+#include <stdio.h>
+#include "dm.h"
+
+/* error messages */
+static char DUP_SIZE[] =  "more than one SIZE option in a format";
+static char DUP_RADIX[] = "more than one RADIX option in a format";
+static char NOMEM[] =     "out of memory";
+
+/*
+ * Record an error message.  Returns -1.
+ */
+	static int
+fail(struct dmctx *c, char *msg)
+{
+	snprintf(c->error, sizeof(c->error), "%s", msg);
+	return (-1);
+}
+
+/*
+ * Get the value of a single digit of an integer.
+ */
+	int
+gdigit(int ch)
+{
+	if (ch >= '0' && ch <= '9')
+		return (ch - '0');
+	if (ch >= 'a' && ch <= 'f')
+		return (ch - 'a' + 10);
+	if (ch >= 'A' && ch <= 'F')
+		return (ch - 'A' + 10);
+	return (-1);
+}
+
+/*
+ * Parse an integer.
+ * It is as big as a file offset, which is 64 bits even
+ * where a long is not.
+ * Returns -1 if there is no number.
+ */
+	int
+getnum(char **ss, off_t *np)
+{
+	char *s = *ss;
+	off_t n;
+	int radix;
+	int v;
+
+	/*
+	 * Default radix is decimal.
+	 */
+	radix = 10;
+
+	if (*s == '0' && s[1] != '\0') {
+		/*
+		 * If it starts with a 0, we use an alternate radix.
+		 * Plain zero means octal.  0x means hex.
+		 */
+		s++;
+		radix = 8;
+		if (*s == 'x' || *s == 'X') {
+			s++;
+			radix = 16;
+		}
+	}
+
+	/*
+	 * Parse the digits of the number.
+	 */
+	n = 0;
+	while ((v = gdigit(*s)) >= 0 && v < radix) {
+		n = (radix * n) + v;
+		s++;
+	}
+	if (s == *ss)
+		return (-1);
+
+	/*
+	 * Followed by "k" means multiply by 1024,
+	 * "m" means multiply by 1024*1024, and
+	 * "g" means multiply by 1024*1024*1024.
+	 */
+	if (*s == 'k' || *s == 'K') {
+		s++;
+		n *= 1024;
+	} else if (*s == 'm' || *s == 'M') {
+		s++;
+		n *= 1024*1024;
+	} else if (*s == 'g' || *s == 'G') {
+		s++;
+		n *= 1024*1024*1024;
+	}
+	*ss = s;
+	*np = n;
+	return (0);
+}
+
+	static int
+getint(struct dmctx *c, char **ss, int *np)
+{
+	off_t n;
+
+	if (getnum(ss, &n) < 0)
+		return (fail(c, "missing number"));
+	*np = (int) n;
+	return (0);
+}
+
+/*
+ * Parse a record layout: a list of fields separated by commas.
+ * Each field is u or s (unsigned or signed) followed by its size
+ * in bits (8, 16, 32 or 64), or c# for # characters,
+ * or _# for # bytes of padding which are not printed.
+ * A number may be followed by x, d or o for its radix,
+ * X for uppercase, z to zero pad, or Q or q for its byte order.
+ * Sets *fp to the fields, *np to the number of fields
+ * and *sizep to the size of the record.
+ */
+	static int
+getfields(struct dmctx *c, char *s, struct format **fp, int *np, int *sizep)
+{
+	struct format *fields = NULL;
+	int n = 0;
+	int size = 0;
+	int last = -1;   /* Last field which is printed */
+
+	for (;;) {
+		char type = *s++;
+		int num = 1;
+		int i;
+		if (type == 'c' || type == '_') {
+			if (*s >= '0' && *s <= '9' && getint(c, &s, &num) < 0)
+				return (-1);
+		} else if (type == 'u' || type == 's') {
+			int bits;
+			if (getint(c, &s, &bits) < 0)
+				return (-1);
+			if (bits != 8 && bits != 16 && bits != 32 && bits != 64)
+				return (fail(c, "field size must be 8, 16, 32 or 64 bits"));
+			num = bits / 8;
+		} else {
+			return (fail(c, "bad field in -S option"));
+		}
+		if (num < 1)
+			return (fail(c, "bad field size in -S option"));
+		/*
+		 * Characters are one field each, with nothing between them.
+		 * Padding and numbers are a single field.
+		 */
+		if ((fields = (struct format *) realloc(fields, (n + num) * sizeof(*fields))) == NULL)
+			return (fail(c, NOMEM));
+		for (i = 0;  i < ((type == 'c') ? num : 1);  i++) {
+			struct format *fl = &fields[n++];
+			memset(fl, 0, sizeof(*fl));
+			fl->offset = size;
+			fl->radix = c->def.radix;
+			fl->comma = c->def.comma;
+			fl->flags = c->def.flags & (UPPERCASE|ZEROPAD|DOTCOMMA|DM_BIG_ENDIAN|DM_LITTLE_ENDIAN);
+			fl->after = (type == 'c' && i+1 < num) ? "" : " ";
+			fl->inter = "";
+			if (type == 'c') {
+				fl->radix = 1;
+				fl->size = 1;
+				fl->flags = 0;
+			} else {
+				fl->size = num;
+				if (type == 's')
+					fl->flags |= SIGNED;
+				else if (type == '_')
+					fl->flags |= NOPRINT;
+			}
+			size += fl->size;
+		}
+		for (;  *s != '\0' && *s != ',';  s++) {
+			struct format *fl = &fields[n-1];
+			if (type == 'c' || type == '_')
+				return (fail(c, "bad field in -S option"));
+			switch (*s)
+			{
+			case 'x': fl->radix = 16; break;
+			case 'd': fl->radix = 10; break;
+			case 'o': fl->radix = 8; break;
+			case 'X': fl->flags |= UPPERCASE; break;
+			case 'z': fl->flags |= ZEROPAD; break;
+			case 'Q': fl->flags = (fl->flags & ~DM_LITTLE_ENDIAN) | DM_BIG_ENDIAN; break;
+			case 'q': fl->flags = (fl->flags & ~DM_BIG_ENDIAN) | DM_LITTLE_ENDIAN; break;
+			default: return (fail(c, "bad field in -S option"));
+			}
+		}
+		if (type != '_')
+			last = n-1;
+		if (*s == '\0')
+			break;
+		s++;
+	}
+	if (last < 0)
+		return (fail(c, "no fields to print in -S option"));
+	fields[last].after = "";
+	for (last = 0;  last < n;  last++) {
+		struct format *fl = &fields[last];
+		fl->zwidth = defwidth(fl->radix, fl->size, fl->comma);
+		fl->width = (fl->flags & SIGNED) ? fl->zwidth + 1 : fl->zwidth;
+	}
+	*fp = fields;
+	*np = n;
+	*sizep = size;
+	return (0);
+}
+
+/*
+ * Parse a single format specification.
+ * A single specification generally sets up a single data format.
+ * Exceptions are some options like -n which don't apply to data formats;
+ * -a which sets up the address format;
+ * and -- which sets up defaults for all subsequent formats.
+ * Returns -1 if it is not valid.
+ */
+	int
+dm_parse(struct dmctx *c, char *s)
+{
+	struct format *f;
+	int size;
+	int radix;
+	int flags;
+	int addr;
+	int width;
+	int zwidth;
+	int comma;
+	char optchar = '\0';
+	char *after;
+	char *inter;
+	struct format *fields = NULL;
+	int nfields = 0;
+
+	if (c->ready)
+		return (fail(c, "formats are already complete"));
+	if (*s == '+' && c->nformat == 0 && dm_parse(c, "-") < 0)
+		/*
+		 * If the first format starts with +,
+		 * set up the default format first.
+		 */
+		return (-1);
+	if (*s == '-' || *s == '+') {
+		optchar = *s++;
+		if (optchar == '-' && *s == '-') {
+			/*
+			 * Option starts with double "-".
+			 */
+			optchar = '=';
+			s++;
+		}
+	}
+	flags = 0;
+	size = 0;
+	radix = 0;
+	width = 0;
+	comma = 0;
+	after = NULL;
+	inter = NULL;
+	addr = 0;
+
+	while (*s != '\0')  switch (*s++)
+	{
+	case 'a': /* Applies to address, not data */
+		addr = 1;
+		break;
+	case 'b': /* 8 bit size */
+		if (size)
+			return (fail(c, DUP_SIZE));
+		size = 1;
+		break;
+	case 'c': /* Character (ASCII) */
+		if (size)
+			return (fail(c, DUP_SIZE));
+		if (radix)
+			return (fail(c, DUP_RADIX));
+		radix = 1;
+		size = 1;
+		inter = "";
+		break;
+	case 'C': /* Character (expanded ASCII) */
+		if (size)
+			return (fail(c, DUP_SIZE));
+		size = 1;
+		flags |= ASCHAR;
+		break;
+	case 'd': /* Radix 10 (decimal) */
+		if (radix)
+			return (fail(c, DUP_RADIX));
+		radix = 10;
+		break;
+	case 'E':
+		c->group_line = 1;
+		break;
+	case 'e': /* Print C style escape sequences for characters */
+		flags |= CSTYLE;
+		break;
+	case 'j': /* Left justify */
+		flags |= LEFTJUST;
+		break;
+	case 'k': /* Use color */
+		c->color = 1;
+		break;
+	case 'l': /* 32 bit size */
+		if (size)
+			return (fail(c, DUP_SIZE));
+		size = 4;
+		break;
+	case 'L': /* 64 bit size */
+		if (size)
+			return (fail(c, DUP_SIZE));
+		size = 8;
+		break;
+	case 'm': /* Mnemonic ASCII */
+		flags |= MNEMONIC;
+		break;
+	case 'n': /* Set count (bytes per line) */
+		if (getint(c, &s, &c->count) < 0)
+			return (-1);
+		if (*s != '\0')
+			return (fail(c, "extra characters in -n option"));
+		if (c->count < 1)
+			return (fail(c, "illegal value for -n option"));
+		c->countset = 1;
+		return (0);
+	case 'N': /* Don't print; useful with -a */
+		flags |= NOPRINT;
+		break;
+	case 'o': /* Radix 8 (octal) */
+		if (radix)
+			return (fail(c, DUP_RADIX));
+		radix = 8;
+		break;
+	case 'p': /* Set printing width */
+		if (getint(c, &s, &width) < 0)
+			return (-1);
+		break;
+	case 'q':
+		flags |= DM_LITTLE_ENDIAN;
+		break;
+	case 'Q':
+		flags |= DM_BIG_ENDIAN;
+		break;
+	case 'r': /* Set arbitrary radix */
+		if (radix)
+			return (fail(c, DUP_RADIX));
+		if (getint(c, &s, &radix) < 0)
+			return (-1);
+		if (radix < 2 || radix > 36)
+			return (fail(c, "invalid radix"));
+		break;
+	case 'S': /* Record of fields */
+		if (size)
+			return (fail(c, DUP_SIZE));
+		if (getfields(c, s, &fields, &nfields, &size) < 0)
+			return (-1);
+		s += strlen(s);
+		flags |= RECORD;
+		break;
+	case 's': /* Signed numbers */
+		flags |= SIGNED;
+		break;
+	case 'T': /* Machine readable output */
+		if (strcmp(s, "json") == 0)
+			c->mode = OUT_JSON;
+		else if (strcmp(s, "csv") == 0)
+			c->mode = OUT_CSV;
+		else if (strcmp(s, "bin") == 0)
+			c->mode = OUT_BIN;
+		else if (strcmp(s, "text") == 0)
+			c->mode = OUT_TEXT;
+		else
+			return (fail(c, "-T must be json, csv, bin or text"));
+		return (0);
+	case 'X': /* Use uppercase for alphabetic digits */
+		flags |= UPPERCASE;
+		break;
+	case 'u': /* UTF-8 chars */
+		if (size)
+			return (fail(c, DUP_SIZE));
+		if (radix)
+			return (fail(c, DUP_RADIX));
+		radix = 1;
+		size = -1; // variable size
+		inter = "";
+		flags |= UTF_8;
+		break;
+	case 'U': /* UTF-8 codepoints */
+		if (size)
+			return (fail(c, DUP_SIZE));
+		size = -1; // variable size
+		flags |= UTF_8|ASCHAR;
+		break;
+	case 'v':
+		c->verbose = 1;
+		return (0);
+	case 'W': /* Use a table for 16 bit items */
+		flags |= WTABLE;
+		break;
+	case 'w': /* 16 bit size */
+		if (size)
+			return (fail(c, DUP_SIZE));
+		size = 2;
+		break;
+	case 'x': /* Radix 16 (hex) */
+		if (radix)
+			return (fail(c, DUP_RADIX));
+		radix = 16;
+		break;
+	case 'z': /* Zero pad */
+		flags |= ZEROPAD;
+		break;
+	case '.':
+		flags |= DOTCOMMA;
+		/* fall thru */
+	case ',':
+		if (getint(c, &s, &comma) < 0)
+			return (-1);
+		break;
+	default:
+		snprintf(c->error, sizeof(c->error), "illegal option letter -%c", s[-1]);
+		return (-1);
+	}
+	if (radix == 0)
+		radix = 16;
+	else if ((flags & (UTF_8|ASCHAR)) == (UTF_8|ASCHAR)) // specified -U and a radix
+		flags |= DM_CODEPT;
+
+	if (optchar == '=') {
+		/*
+		 * The option started with "--".
+		 * Just change some defaults; don't set up a format.
+		 */
+		if (addr)
+			return (fail(c, "cannot use -a in a default (--) option"));
+		if (flags & RECORD)
+			return (fail(c, "cannot use -S in a default (--) option"));
+		if (width != 0)
+			return (fail(c, "cannot set default for -p"));
+		if (size != 0)
+			c->def.size = size;
+		if (radix != 0)
+			c->def.radix = radix;
+		if (flags != 0)
+			c->def.flags = flags;
+		if (comma != 0)
+			c->def.comma = comma;
+		return (0);
+	}
+
+	/*
+	 * Set up the format structure.
+	 */
+	if (addr) {
+		/*
+		 * Don't fill in any defaults for the address format.
+		 * We take care of that later, in fixaformat().
+		 */
+		f = &c->aformat;
+		if (radix == 1 || (flags & (ASCHAR|UTF_8|MNEMONIC|CSTYLE|RECORD)))
+			return (fail(c, "invalid option used with -a"));
+		zwidth = 0;
+	} else {
+		/*
+		 * Fill in defaults for anything not specified.
+		 */
+		if (size == 0)
+			size = c->def.size;
+		if (radix == 0)
+			radix = c->def.radix;
+		if (comma == 0)
+			comma = c->def.comma;
+		flags |= c->def.flags;
+		if (radix == 1 || (flags & (ASCHAR|UTF_8)))
+			flags &= ~SIGNED;
+		if (after == NULL)
+			after = "\n";
+		if (inter == NULL)
+			inter = " ";
+		zwidth = (flags & RECORD) ? 0 : defwidth(radix, size, comma);
+		if (width == 0 && !(flags & RECORD)) {
+			/*
+			 * Set up printing width to be just big enough to
+			 * hold the widest string we'll ever need to print.
+			 */
+			width = defwidth(radix, size, comma);
+			if (flags & SIGNED)
+				/* Add one for a possible minus sign. */
+				width++;
+			if ((flags & (ASCHAR|MNEMONIC)) == (ASCHAR|MNEMONIC) &&
+				width < 3)
+				/*
+				 * Need at least 3 printing positions to
+				 * display ASCII mnemonics.
+				 */
+				zwidth = width = 3;
+			if ((flags & (ASCHAR|CSTYLE)) == (ASCHAR|CSTYLE) &&
+				width < 2)
+				/*
+				 * Need at least 2 printing positions to
+				 * display C style mnemonics.
+				 */
+				zwidth = width = 2;
+		}
+		if (flags & RECORD) {
+			/*
+			 * The width of a record is the width of its fields.
+			 */
+			int i;
+			width = 0;
+			for (i = 0;  i < nfields;  i++)
+				if (!(fields[i].flags & NOPRINT))
+					width += fields[i].width + strlen(fields[i].after);
+			zwidth = width;
+		}
+
+		if (c->nformat >= c->maxformat) {
+			c->maxformat = (c->maxformat == 0) ? 16 : 2 * c->maxformat;
+			if ((c->format = (struct format *) realloc(c->format,
+					c->maxformat * sizeof(struct format))) == NULL)
+				return (fail(c, NOMEM));
+		}
+		/*
+		 * Figure out the column for this format.
+		 *
+		 * This is a "logical column" assigned as follows:
+		 * The first format on each line is column 0.
+		 * Any format immediately to the right of a column 0
+		 * format is column 1, and so on.
+		 */
+		if (c->nformat == 0) {
+			/*
+			 * The column of the first format must be 0.
+			 */
+			c->format[c->nformat].col = 0;
+		} else if (optchar == '+') {
+			/*
+			 * Display NEXT TO the previous format.
+			 * Set the previous format's "after" string
+			 * to spaces, and set our column to one more
+			 * than the previous format's column.
+			 */
+			c->format[c->nformat-1].after = "   ";
+			c->format[c->nformat].col = c->format[c->nformat-1].col + 1;
+		} else {
+			/*
+			 * Display UNDER the previous format
+			 * (that is, at the start of the next line).
+			 * The previous format's "after" string
+			 * becomes a newline and some spaces
+			 * in setaddrtab(); set our column to 0.
+			 */
+			c->format[c->nformat].col = 0;
+		}
+		f = &c->format[c->nformat++];
+	}
+
+	/*
+	 * Set up the new format structure.
+	 */
+	f->radix = radix;
+	f->size = size;
+	f->width = width;
+	f->zwidth = zwidth;
+	f->flags = flags;
+	f->comma = comma;
+	f->after = after;
+	f->inter = inter;
+	f->fields = fields;
+	f->nfields = nfields;
+	return (0);
+}
+
+/*
+ * Initialize the address format.
+ * It may already be partially initialized by a -a option.
+ */
+	static void
+fixaformat(struct dmctx *c)
+{
+	struct format *af = &c->aformat;
+
+	af->size = sizeof(off_t);
+	af->after = ": ";
+	af->inter = "";
+
+	if (af->radix == 0)
+		af->radix = c->def.radix;
+	if (af->comma == 0)
+		af->comma = c->def.comma;
+
+	/*
+	 * Keep only the flags which are meaningful for addresses.
+	 */
+	af->flags |= c->def.flags;
+	af->flags &= NOPRINT|LEFTJUST|ZEROPAD|UPPERCASE|DOTCOMMA;
+
+	/*
+	 * Set up the width and zwidth.
+	 */
+	af->zwidth = defwidth(af->radix, af->size, af->comma);
+	if (af->width == 0)
+		af->width = af->zwidth;
+	if (af->width > 10) af->width = 10; // FIXME??
+	if (af->zwidth > af->width)
+		af->zwidth = af->width;
+}
+
+/*
+ * Set up the addrtab string.
+ * addrtab is used as the "after" string of the last format
+ * in a printable line (other than the last line),
+ * to print a newline followed by enough spaces
+ * to tab past the address displayed on the first line.
+ */
+	static int
+setaddrtab(struct dmctx *c)
+{
+	int width;
+	int i;
+
+	/*
+	 * Append enough spaces to equal the width of the address.
+	 */
+	width = c->aformat.width + strlen(c->aformat.after);
+	if ((c->addrtab = (char *) malloc(width + 2)) == NULL)
+		return (fail(c, NOMEM));
+	c->addrtab[0] = '\n';
+	for (i = 0;  i < width;  i++)
+		c->addrtab[i+1] = ' ';
+	c->addrtab[i+1] = '\0';
+
+	for (i = 0;  i+1 < c->nformat;  i++)
+		if (c->format[i+1].col == 0)
+			c->format[i].after = c->addrtab;
+	return (0);
+}
+
+/*
+ * Give a format which has no byte order (and its fields)
+ * the byte order of this machine.
+ */
+	static void
+setorder(struct dmctx *c, struct format *f)
+{
+	int i;
+
+	if (!(f->flags & (DM_BIG_ENDIAN|DM_LITTLE_ENDIAN)))
+		f->flags |= c->bigendian ? DM_BIG_ENDIAN : DM_LITTLE_ENDIAN;
+	for (i = 0;  i < f->nfields;  i++)
+		setorder(c, &f->fields[i]);
+}
+
+/*
+ * Adjust the width (printable size) of each format
+ * to make the columns line up nicely.
+ */
+	static void
+adjcol(struct dmctx *c)
+{
+	int col;
+	struct format *f;
+	int found;
+	int nitems;     /* Formats of items (not records) in the column */
+	int minsize;
+	int maxwidth8;
+	int width8;
+
+	for (col = 0; ; col++) {
+		/*
+		 * Find the smallest size and the largest width in this column.
+		 * Actually, we don't look at the width, but the width8:
+		 * the printable width of 8 bytes of data (whereas
+		 * width is the printable size of "size" bytes of data).
+		 * This lets us compare formats which have different sizes.
+		 * We also count any trailing space (f->inter) in the width8.
+		 */
+		found = 0;
+		nitems = 0;
+		minsize = 8;
+		maxwidth8 = 0;
+
+		for (f = c->format;  f < &c->format[c->nformat];  f++)
+			if (f->col == col) {
+				int psize = (f->size > 0) ? f->size : 1;
+				found++;
+				if (f->flags & RECORD)
+					/* A record's fields are not adjusted. */
+					continue;
+				nitems++;
+				if (psize < minsize)
+					minsize = psize;
+				width8 = (8 / psize) *
+						(f->width + strlen(f->inter));
+				if (width8 > maxwidth8)
+					maxwidth8 = width8;
+			}
+
+		if (!found)
+			/*
+			 * Nothing in this column; we're done.
+			 */
+			return;
+		if (nitems == 0)
+			continue;
+
+		/*
+		 * Now round up the max width8 to be divisible into
+		 * pieces as required by the min size.
+		 */
+		minsize = 8 / minsize;
+		maxwidth8 = (maxwidth8 + minsize - 1) / minsize;
+		maxwidth8 *= minsize;
+
+		/*
+		 * Run thru again, adjusting (rounding up) the width
+		 * for each format in this column.
+		 */
+		for (f = c->format;  f < &c->format[c->nformat];  f++) {
+			int psize = (f->size > 0) ? f->size : 1;
+			if (f->col == col && !(f->flags & RECORD)) {
+				width8 = 8 / psize;
+				f->width = (maxwidth8 / width8) -
+						strlen(f->inter);
+				if (strlen(f->inter) == 0 && f->width > 1) {
+					/*
+					 * Ugly kludge to handle characters:
+					 * Normally, -c format has the inter
+					 * string empty and width == 1.
+					 * If we have adjusted the width to
+					 * be > 1, then use the inter string
+					 * for one of the spaces.
+					 * This makes the chars line up
+					 * better with other formats.
+					 */
+					f->inter = " ";
+					f->width--;
+				}
+			}
+		}
+	}
+}
+
+/*
+ * Finish setting up the formats, once all the specifications
+ * have been parsed.  If none set up a format, the default
+ * formats (hex bytes and ASCII) are used.
+ */
+	int
+dm_ready(struct dmctx *c)
+{
+	int recsize = 0;
+	int fx;
+
+	if (c->ready)
+		return (0);
+	if (c->nformat == 0 && (dm_parse(c, "-xb") < 0 || dm_parse(c, "+c") < 0))
+		return (-1);
+
+	/*
+	 * A record format sets the number of bytes per line.
+	 */
+	for (fx = 0;  fx < c->nformat;  fx++) {
+		if (!(c->format[fx].flags & RECORD))
+			continue;
+		if (c->countset)
+			return (fail(c, "cannot use -n with -S"));
+		if (recsize != 0 && c->format[fx].size != recsize)
+			return (fail(c, "records of different sizes"));
+		recsize = c->format[fx].size;
+	}
+	if (recsize != 0)
+		c->count = recsize;
+
+	fixaformat(c);
+	if (setaddrtab(c) < 0)
+		return (-1);
+	adjcol(c);
+
+	/*
+	 * Set up the render plan for the address format and each data format.
+	 */
+	setorder(c, &c->aformat);
+	setplan(&c->aformat);
+	for (fx = 0;  fx < c->nformat;  fx++) {
+		if (c->color)
+			c->format[fx].flags |= COLOR;
+		setorder(c, &c->format[fx]);
+		setplan(&c->format[fx]);
+	}
+	if (c->mode != OUT_TEXT) {
+		/* Every line is a record; none are collapsed. */
+		c->verbose = 1;
+		if (setcolumns(c) < 0)
+			return (fail(c, NOMEM));
+	}
+	c->ready = 1;
+	return (0);
+}
@@ -0,0 +1,492 @@
+/*
+ * Read input data.
+ *
+ * A regular file is mapped into memory and lines are handed out
+ * as pointers directly into the mapping.
+ * Anything else (a pipe, a terminal, or a file we cannot map)
+ * is read in large blocks into a buffer, and lines are walked
+ * inside the buffer.
+ * Either way, in_fill() makes the next line (plus some lookahead)
+ * contiguous at in->data, and the previous line is always
+ * available just before it, so duplicate lines can be compared in place.
+ * A file which can seek is read with pread, so that in_seek()
+ * can move anywhere in it; one which can't is only read forward.
+ * Holes in a sparse file can be found without reading them,
+ * and skipped.
+ * Compressed input is read through a decompressor (see decomp.c).
+ */
+
+#define _GNU_SOURCE /* for SEEK_DATA and SEEK_HOLE */
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include "dm.h"
+
+extern int stats;
+extern __thread struct stats tstats;
+
+static ssize_t in_read(struct input *in, u8 *buf, size_t len, off_t addr);
+
+/*
+ * Try to map a regular file into memory.
+ */
+	static void
+in_map(struct input *in)
+{
+	struct stat st;
+	void *map;
+
+	if (fstat(in->fd, &st) < 0 || !S_ISREG(st.st_mode))
+		return;
+	if (st.st_size == 0) {
+		/* Nothing to map; but no need to read either. */
+		in->eof = 1;
+		return;
+	}
+	if ((off_t) (size_t) st.st_size != st.st_size)
+		/* Too big to map on this machine. */
+		return;
+	map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, in->fd, 0);
+	if (map == MAP_FAILED)
+		return;
+	madvise(map, (size_t) st.st_size, MADV_SEQUENTIAL);
+	in->map = in->data = (u8 *) map;
+	in->mapsize = in->len = (size_t) st.st_size;
+	in->eof = 1;
+	tstats.bytesmapped += in->mapsize;
+}
+
+/*
+ * Open an input file.
+ * "-" means standard input.
+ * hist is the number of bytes before in->data which must
+ * remain valid after in_fill (that is, the previous line).
+ * If canmap is set, a regular file is mapped rather than read.
+ * A compressed file is decompressed.
+ */
+	int
+in_open(struct input *in, char *filename, size_t hist, int canmap)
+{
+	struct stat st;
+	u8 head[MAGICLEN];
+	ssize_t n;
+
+	in->map = NULL;
+	in->mapsize = 0;
+	in->rbuf = NULL;
+	in->len = 0;
+	in->hist = hist;
+	in->eof = 0;
+	in->addr = 0;
+	in->end = -1;
+	in->base = -1;
+	in->wfd = -1;
+	in->pid = in->feeder = 0;
+	in->decomp = NULL;
+	if (strcmp(filename, "-") == 0) {
+		/* Standard input */
+		in->fd = 0;
+		in->name = "standard input";
+	} else if ((in->fd = open(filename, O_RDONLY|O_CLOEXEC)) < 0) {
+		fprintf(stderr, "cannot open <%s>\n", filename);
+		return (-1);
+	} else {
+		in->name = filename;
+	}
+	if (fstat(in->fd, &st) == 0 && S_ISREG(st.st_mode))
+		/* Addresses count from where the file is now. */
+		in->base = lseek(in->fd, 0, SEEK_CUR);
+	if (in->base >= 0 && (n = pread(in->fd, head, MAGICLEN, in->base)) > 0 &&
+			in_decompress(in, head, (size_t) n) < 0) {
+		in_close(in);
+		return (-1);
+	}
+	if (canmap && in->base == 0)
+		in_map(in);
+	if (in->map == NULL) {
+		/*
+		 * Size the read buffer so that many lines fit in it,
+		 * but never less than two lines plus lookahead.
+		 */
+		in->rsize = INBUFSIZE;
+		if (in->rsize < 2 * (hist + LOOKAHEAD))
+			in->rsize = 2 * (hist + LOOKAHEAD);
+		if ((in->rbuf = (u8 *) malloc(in->rsize)) == NULL)
+			panic("cannot allocate input buffer");
+	}
+	in->data = (in->map != NULL) ? in->map : in->rbuf;
+	if (in->base < 0 && in->decomp == NULL) {
+		/*
+		 * To see whether input which can't seek is compressed,
+		 * read its start; if it is not, that is the first data.
+		 */
+		while (in->len < MAGICLEN) {
+			if ((n = in_read(in, in->data + in->len, MAGICLEN - in->len, 0)) <= 0)
+				break;
+			in->len += n;
+		}
+		if (in->len < MAGICLEN)
+			in->eof = 1;
+		switch (in_decompress(in, in->data, in->len))
+		{
+		case 1:
+			in->len = 0;
+			in->eof = 0;
+			break;
+		case -1:
+			in_close(in);
+			return (-1);
+		}
+	}
+	return (0);
+}
+
+/*
+ * Return the size of the input file, or -1 if it has none.
+ */
+	off_t
+in_size(struct input *in)
+{
+	struct stat st;
+
+	if (in->map != NULL)
+		return ((off_t) in->mapsize);
+	if (in->base < 0 || fstat(in->fd, &st) < 0)
+		return (-1);
+	return (st.st_size - in->base);
+}
+
+/*
+ * Read len bytes into buf from file address addr,
+ * retrying if interrupted.
+ * A file which can't seek is read from wherever it is.
+ * Returns the number of bytes read, 0 at end of file, or -1 on error.
+ */
+	static ssize_t
+in_read(struct input *in, u8 *buf, size_t len, off_t addr)
+{
+	ssize_t n;
+	double t = stats ? stat_now() : 0;
+
+	for (;;) {
+		if (in->base >= 0)
+			n = pread(in->fd, buf, len, in->base + addr);
+		else
+			n = read(in->fd, buf, len);
+		if (n >= 0) {
+			if (stats)
+				tstats.tread += stat_now() - t;
+			tstats.bytesread += n;
+			return (n);
+		}
+		if (errno != EINTR) {
+			fprintf(stderr, "cannot read %s\n", in->name);
+			return (-1);
+		}
+	}
+}
+
+/*
+ * Forget what is in the read buffer, and start reading at addr.
+ * The history before the new position reads as zeros.
+ */
+	static void
+in_reset(struct input *in, off_t addr)
+{
+	memset(in->rbuf, 0, in->hist);
+	in->data = in->rbuf + in->hist;
+	in->len = 0;
+	in->addr = addr;
+	in->eof = 0;
+}
+
+/*
+ * Report progress on a long skip every this many bytes.
+ */
+#define SKIPREPORT (256*1024*1024)
+
+/*
+ * Throw away the next n bytes of a file which can't seek.
+ * Data from a pipe is spliced into /dev/null, so it never
+ * has to be copied; anything else is read in large blocks.
+ * Returns the number of bytes thrown away,
+ * which is less than n only at end of file.
+ */
+	static off_t
+in_discard(struct input *in, off_t n)
+{
+	struct stat st;
+	int devnull = -1;
+	int report = (n >= SKIPREPORT && isatty(2));
+	off_t done = 0;
+	off_t next = SKIPREPORT;
+
+#ifdef SPLICE_F_MOVE
+	if (fstat(in->fd, &st) == 0 && S_ISFIFO(st.st_mode))
+		devnull = open("/dev/null", O_WRONLY|O_CLOEXEC);
+#endif
+	while (done < n) {
+		off_t len = n - done;
+		ssize_t nread = -1;
+#ifdef SPLICE_F_MOVE
+		if (devnull >= 0) {
+			if (len > SKIPREPORT)
+				len = SKIPREPORT;
+			nread = splice(in->fd, NULL, devnull, NULL, (size_t) len, SPLICE_F_MOVE);
+			if (nread < 0 && errno == EINTR)
+				continue;
+			if (nread < 0) {
+				/* Can't splice after all; just read. */
+				close(devnull);
+				devnull = -1;
+				continue;
+			}
+		}
+#endif
+		if (devnull < 0) {
+			if (len > (off_t) in->rsize)
+				len = in->rsize;
+			nread = in_read(in, in->rbuf, (size_t) len, in->addr + done);
+		}
+		if (nread <= 0)
+			break;
+		done += nread;
+		if (report && done >= next) {
+			fprintf(stderr, "\rdm: skipping %s: %lld of %lld MB",
+				in->name, (long long) (done >> 20), (long long) (n >> 20));
+			next += SKIPREPORT;
+		}
+	}
+	if (report)
+		fprintf(stderr, "\r\033[K");
+	if (devnull >= 0)
+		close(devnull);
+	tstats.discarded += done;
+	return (done);
+}
+
+/*
+ * Go to file address offset, and limit the input to length bytes
+ * from there (unless length is negative).
+ * A mapped file just moves its data pointer, and a file which can
+ * seek is just read from there.  Anything else is read (or spliced)
+ * up to the offset, so it can only go forward.
+ * If byread is set, the offset must be in the file,
+ * as if we had read up to it.
+ */
+	int
+in_seek(struct input *in, off_t offset, off_t length, int byread)
+{
+	in->end = (length < 0) ? -1 : offset + length;
+	if (in->map != NULL) {
+		size_t pos = (offset > (off_t) in->mapsize) ? in->mapsize : (size_t) offset;
+		in->data = in->map + pos;
+		in->len = in->mapsize - pos;
+		in->addr = offset;
+	} else if (offset >= in->addr && offset <= in->addr + (off_t) in->len) {
+		/* Already have it. */
+		in_advance(in, (size_t) (offset - in->addr));
+	} else if (in->base >= 0) {
+		/* Just read from there. */
+		if (byread && offset > in_size(in)) {
+			fprintf(stderr, "cannot read to %lld in %s\n",
+				(long long) offset, in->name);
+			return (-1);
+		}
+		in_reset(in, offset);
+	} else if (offset < in->addr) {
+		fprintf(stderr, "cannot go back to %lld in %s\n",
+			(long long) offset, in->name);
+		return (-1);
+	} else {
+		off_t skip = offset - in->addr - in->len;
+		in_advance(in, in->len);
+		if (in_discard(in, skip) < skip) {
+			fprintf(stderr, "cannot read to %lld in %s\n",
+				(long long) offset, in->name);
+			return (-1);
+		}
+		in_reset(in, offset);
+	}
+	return (0);
+}
+
+/*
+ * Make at least need bytes available at in->data,
+ * unless we hit the end of the file (or of the range) first.
+ * Returns the number of bytes available, which may exceed need.
+ */
+	size_t
+in_fill(struct input *in, size_t need)
+{
+	if (in->len < need && !in->eof) {
+		if (in->data + need > in->rbuf + in->rsize) {
+			/*
+			 * Not enough room left at the end of the buffer.
+			 * Shift the unconsumed data, and the history before it,
+			 * to the start of the buffer.
+			 */
+			size_t keep = in->data - in->rbuf;
+			if (keep > in->hist)
+				keep = in->hist;
+			memmove(in->rbuf, in->data - keep, keep + in->len);
+			in->data = in->rbuf + keep;
+		}
+		/*
+		 * Read as much as fits; a pipe may return less than we ask for,
+		 * so keep reading until we have enough.
+		 */
+		while (in->len < need) {
+			u8 *end = in->data + in->len;
+			off_t room = in->rbuf + in->rsize - end;
+			ssize_t nread;
+			if (in->end >= 0 && in->base >= 0 &&
+					room > in->end - in->addr - (off_t) in->len)
+				/* No need to read past the end of the range. */
+				room = in->end - in->addr - (off_t) in->len;
+			if (room <= 0)
+				break;
+			nread = in_read(in, end, (size_t) room, in->addr + in->len);
+			if (nread <= 0) {
+				in->eof = 1;
+				break;
+			}
+			in->len += nread;
+		}
+	}
+	if (in->end >= 0 && in->addr + (off_t) in->len > in->end)
+		/* Data after the end of the range is kept for later. */
+		return ((in->addr >= in->end) ? 0 : (size_t) (in->end - in->addr));
+	return (in->len);
+}
+
+/*
+ * Find the first hole in the file at or after address addr.
+ * Sets *startp and *endp to the addresses of the start of the hole
+ * and of the data after it (or the end of the file).
+ * Returns -1 if there is no hole, or if the file can't tell us.
+ */
+	int
+in_hole(struct input *in, off_t addr, off_t *startp, off_t *endp)
+{
+#ifdef SEEK_HOLE
+	off_t start;
+	off_t end;
+
+	/* Files are read with pread, so moving the offset does no harm. */
+	if (in->base < 0)
+		return (-1);
+	if ((start = lseek(in->fd, in->base + addr, SEEK_HOLE)) < 0)
+		return (-1);
+	end = lseek(in->fd, start, SEEK_DATA);
+	if (end < 0)
+		/* No data after the hole (ENXIO): it runs to end of file. */
+		end = lseek(in->fd, 0, SEEK_END);
+	if (end <= start)
+		/* Only the implied hole at end of file. */
+		return (-1);
+	*startp = start - in->base;
+	*endp = end - in->base;
+	return (0);
+#else
+	return (-1);
+#endif
+}
+
+/*
+ * Consume n bytes of input, which are known to be in a hole.
+ * Anything not yet read is skipped rather than read;
+ * the history before the new position then reads as zeros,
+ * as the file would.
+ */
+	void
+in_skiphole(struct input *in, off_t n)
+{
+	if (n <= (off_t) in->len)
+		in_advance(in, (size_t) n);
+	else
+		in_reset(in, in->addr + n);
+}
+
+/*
+ * Consume n bytes of input.
+ */
+	void
+in_advance(struct input *in, size_t n)
+{
+	if (n > in->len)
+		n = in->len;
+	in->data += n;
+	in->len -= n;
+	in->addr += n;
+}
+
+/*
+ * Wait for a file to grow beyond the data we have read.
+ * Returns 0 when there may be more to read,
+ * or -1 if the file can't grow (it isn't a regular file)
+ * or has been truncated.
+ * We wait with inotify if we can, and otherwise check once a second.
+ */
+	int
+in_wait(struct input *in)
+{
+	struct stat st;
+	off_t have = in->addr + in->len;
+
+	if (in->base < 0)
+		return (-1);
+#ifdef __linux__
+	if (in->wfd < 0 && in->fd != 0 &&
+			(in->wfd = inotify_init1(IN_CLOEXEC)) >= 0 &&
+			inotify_add_watch(in->wfd, in->name, IN_MODIFY|IN_ATTRIB) < 0) {
+		close(in->wfd);
+		in->wfd = -1;
+	}
+#endif
+	for (;;) {
+		if (fstat(in->fd, &st) < 0)
+			return (-1);
+		if (st.st_size - in->base < have) {
+			fprintf(stderr, "dm: %s: file truncated\n", in->name);
+			return (-1);
+		}
+		if (st.st_size - in->base > have)
+			break;
+		if (in->wfd >= 0) {
+			/* Any event means the file may have changed. */
+			char ev[4096];
+			if (read(in->wfd, ev, sizeof(ev)) < 0 && errno != EINTR)
+				return (-1);
+		} else {
+			sleep(1);
+		}
+	}
+	in->eof = 0;
+	return (0);
+}
+
+/*
+ * Close an input file.
+ * Returns -1 if it was decompressed, and the decompressor failed.
+ */
+	int
+in_close(struct input *in)
+{
+	if (in->wfd >= 0)
+		close(in->wfd);
+	if (in->map != NULL)
+		munmap(in->map, in->mapsize);
+	free(in->rbuf);
+	if (in->fd != 0)
+		close(in->fd);
+	if (in->decomp != NULL)
+		return (in_endecompress(in));
+	return (0);
+}
@@ -0,0 +1,329 @@
+/*
+ * The library interface: dump contexts, and printing lines of data.
+ *
+ * Everything needed to print a line is in the context or the
+ * arguments, and output goes to the calling thread's current
+ * output buffer (see prsetout), so lines may be printed by several
+ * threads at once, with the same context or different ones.
+ */
+
+#include <time.h>
+#include "dm.h"
+
+/*
+ * The counts for --stats are kept as lines are printed, so they are
+ * here; stats.c adds them up and reports them.
+ */
+int stats = 0;                 /* --stats was given */
+__thread struct stats tstats;  /* This thread's counts */
+
+	double
+stat_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+/*
+ * Make room for the times of nformat formats in this thread's counts.
+ * This is done for the first line a thread prints.
+ */
+	void
+stat_grow(int nformat)
+{
+	tstats.tformat = (double *) realloc(tstats.tformat, nformat * sizeof(double));
+	if (tstats.tformat == NULL)
+		panic("cannot allocate stats");
+	while (tstats.nformat < nformat)
+		tstats.tformat[tstats.nformat++] = 0;
+}
+
+	static int
+is_bigendian(void)
+{
+	u32 one = 1;
+	return (*(u8*)&one != 1);
+}
+
+/*
+ * Create a context with no formats, and the default settings.
+ */
+	struct dmctx *
+dm_new(void)
+{
+	struct dmctx *c;
+
+	if ((c = (struct dmctx *) calloc(1, sizeof(*c))) == NULL)
+		return (NULL);
+	c->bigendian = is_bigendian();
+	/*
+	 * The default format is used for any unspecified attributes
+	 * of a format.  Parts of it may be changed by a -- option.
+	 */
+	c->def.radix = 16;
+	c->def.size = 1;
+	c->count = 16;
+	return (c);
+}
+
+	void
+dm_free(struct dmctx *c)
+{
+	int fx;
+
+	if (c == NULL)
+		return;
+	for (fx = 0;  fx < c->nformat;  fx++)
+		free(c->format[fx].fields);
+	free(c->format);
+	free(c->addrtab);
+	free(c->columns);
+	free(c);
+}
+
+	char *
+dm_error(struct dmctx *c)
+{
+	return (c->error);
+}
+
+/*
+ * The most bytes one line can take: every item at its widest,
+ * plus a newline after the line group,
+ * plus room for a copy of the line itself (see markline).
+ */
+	size_t
+dm_linemax(struct dmctx *c)
+{
+	size_t n;
+	int fx;
+	int i;
+
+	if (dm_ready(c) < 0)
+		return (0);
+	n = itemmax(&c->aformat) + strlen(c->aformat.after) + 1;
+	n += c->count + LOOKAHEAD;
+	for (fx = 0;  fx < c->nformat;  fx++) {
+		struct format *f = &c->format[fx];
+		if (f->flags & RECORD) {
+			for (i = 0;  i < f->nfields;  i++)
+				n += itemmax(&f->fields[i]) + strlen(f->fields[i].after);
+		} else {
+			/* An item is at least one byte. */
+			n += c->count * itemmax(f);
+		}
+		n += strlen(f->after);
+	}
+	if (c->mode != OUT_TEXT) {
+		/*
+		 * A record: the address and every column as 20 digits,
+		 * a sign and a separator, plus the punctuation.
+		 */
+		size_t m = 32 + c->ncolumns * 22 + c->nformat * 3;
+		m += c->count + LOOKAHEAD;
+		if (m > n)
+			n = m;
+	}
+	return (n);
+}
+
+/*
+ * Print the header which comes before the lines of
+ * machine readable output (-T) into a buffer.
+ */
+	ssize_t
+dm_header(struct dmctx *c, char *buf, size_t size)
+{
+	struct outbuf ob;
+	struct outbuf *old;
+
+	if (dm_ready(c) < 0)
+		return (-1);
+	if (size < machheadmax(c)) {
+		snprintf(c->error, sizeof(c->error), "buffer is too small for the header");
+		return (-1);
+	}
+	ob.buf = buf;
+	ob.len = 0;
+	ob.size = size;
+	ob.fd = OUTFIXED;
+	ob.tty = 0;
+	ob.line = NULL;
+	ob.linesize = 0;
+	ob.full = 0;
+	old = prsetout(&ob);
+	machheader(c);
+	prsetout(old);
+	if (ob.full) {
+		snprintf(c->error, sizeof(c->error), "buffer is too small for the header");
+		return (-1);
+	}
+	return (ob.len);
+}
+
+/*
+ * Print the lines of len bytes of data into a buffer.
+ * Repeated lines are collapsed into a "*" as dm does,
+ * but the first line printed by each call is always shown.
+ */
+	ssize_t
+dm_render(struct dmctx *c, u8 *data, size_t len, long long addr,
+	char *buf, size_t size, size_t *usedp)
+{
+	struct outbuf ob;
+	struct outbuf *old;
+	struct dumpstate st;
+	size_t linemax;
+	size_t done = 0;
+
+	*usedp = 0;
+	if ((linemax = dm_linemax(c)) == 0)
+		return (-1);
+	if (size < linemax && len > 0) {
+		snprintf(c->error, sizeof(c->error), "buffer is too small for a line");
+		return (-1);
+	}
+	/*
+	 * The end of the buffer holds the copy of the last line.
+	 */
+	ob.linesize = c->count + LOOKAHEAD;
+	ob.line = (u8 *) buf + size - ob.linesize;
+	ob.buf = buf;
+	ob.len = 0;
+	ob.size = size - ob.linesize;
+	ob.fd = OUTFIXED;
+	ob.tty = 0;
+	ob.full = 0;
+	old = prsetout(&ob);
+	st.firstaddr = addr;
+	st.last_len = 0;
+	st.didstar = 0;
+	while (done < len && !ob.full && ob.size - ob.len >= linemax - ob.linesize) {
+		dumpline(c, &st, addr + done, data + done, len - done);
+		done += c->count;
+	}
+	prsetout(old);
+	if (ob.full) {
+		snprintf(c->error, sizeof(c->error), "buffer is too small for a line");
+		return (-1);
+	}
+	*usedp = (done < len) ? done : len;
+	return (ob.len);
+}
+
+/*
+ * Dump one line.
+ * data points to the line, and avail is the number of bytes there,
+ * which may be more or less than a line.
+ * Unless this is the first line, the previous line is just before data.
+ */
+	void
+dumpline(struct dmctx *c, struct dumpstate *st, off_t addr, u8 *data, size_t avail)
+{
+	/* line_len is amount to print on this line.
+	 * Normally line_len==count unless there is not enough data. */
+	size_t line_len = avail;
+	if (line_len > c->count) line_len = c->count;
+
+	/* Duplicate of the previous line (which is just before this one)? */
+	if (!c->verbose && addr != st->firstaddr &&
+			line_len == st->last_len && eqbuf(data, data - c->count, line_len)) {
+		/* Just print an asterisk (unless we've already done so). */
+		if (!st->didstar) {
+			prstring("*\n");
+			prendline();
+		}
+		st->didstar = 1;
+		tstats.starred++;
+		tstats.bytesdumped += line_len;
+		return;
+	}
+	st->didstar = 0;
+	st->last_len = line_len;
+	markline(c, addr, data, avail, NULL);
+}
+
+/*
+ * Print one line like markline, timing each format for --stats.
+ */
+	static void
+marktimed(struct dmctx *c, off_t addr, u8 *line, size_t line_len, size_t avail, u8 *mark)
+{
+	double t = stat_now();
+	double t2;
+	int fx;
+
+	if (tstats.nformat < c->nformat)
+		stat_grow(c->nformat);
+	printbuf(&c->aformat, (u8*) &addr, sizeof(addr), sizeof(addr), sizeof(addr));
+	t2 = stat_now();
+	tstats.taddr += t2 - t;
+	for (fx = 0;  fx < c->nformat;  fx++) {
+		t = t2;
+		if (mark != NULL)
+			prmarked(&c->format[fx], line, c->count, line_len, avail, mark);
+		else
+			printbuf(&c->format[fx], line, c->count, line_len, avail);
+		t2 = stat_now();
+		tstats.tformat[fx] += t2 - t;
+	}
+	if (c->group_line)
+		prstring("\n");
+	prendline();
+}
+
+/*
+ * Print one line, in all formats.
+ * If mark is not NULL, the items with a byte set in mark[]
+ * are highlighted.
+ */
+	void
+markline(struct dmctx *c, off_t addr, u8 *data, size_t avail, u8 *mark)
+{
+	u8 *line = data;
+	int count = c->count;
+
+	/* Only the line and its lookahead are looked at. */
+	if (avail > count + LOOKAHEAD)
+		avail = count + LOOKAHEAD;
+	size_t line_len = avail;
+	if (line_len > count) line_len = count;
+	if (avail < count + LOOKAHEAD) {
+		/*
+		 * Near the end of the file.
+		 * Copy the line so that anything examined past
+		 * the end of the data reads as zeros.
+		 */
+		line = prlinebuf(count + LOOKAHEAD);
+		memset(line + avail, 0, count + LOOKAHEAD - avail);
+		memcpy(line, data, avail);
+	}
+
+	tstats.lines++;
+	tstats.bytesdumped += line_len;
+	if (c->mode != OUT_TEXT) {
+		machline(c, addr, line, line_len, avail);
+		return;
+	}
+	if (stats) {
+		marktimed(c, addr, line, line_len, avail, mark);
+		return;
+	}
+
+	/* Print the address, in the address format. */
+	printbuf(&c->aformat, (u8*) &addr, sizeof(addr), sizeof(addr), sizeof(addr));
+
+	/* Print the data, in all formats. */
+	int fx;
+	for (fx = 0;  fx < c->nformat;  fx++) {
+		if (mark != NULL)
+			prmarked(&c->format[fx], line, count, line_len, avail, mark);
+		else
+			printbuf(&c->format[fx], line, count, line_len, avail);
+	}
+	if (c->group_line)
+		prstring("\n");
+	prendline();
+}
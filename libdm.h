@@ -0,0 +1,68 @@
+/*
+ * libdm - print data the way dm does, from a program.
+ *
+ * A context holds a set of formats, set up from the same format
+ * specifications as the dm command line ("-xb", "+c", "-n32", ...):
+ *
+ *	struct dmctx *c = dm_new();
+ *	if (dm_parse(c, "-xw") < 0 || dm_parse(c, "+c") < 0 || dm_ready(c) < 0)
+ *		fprintf(stderr, "%s\n", dm_error(c));
+ *
+ * dm_render() then prints data into a buffer supplied by the caller,
+ * without allocating memory.  Once it is ready, a context is only
+ * read, so any number of threads may render with the same context.
+ */
+
+#include <sys/types.h>
+
+struct dmctx;
+
+/*
+ * Create a context, with no formats.  Returns NULL if out of memory.
+ */
+struct dmctx *dm_new(void);
+
+/*
+ * Add one format specification.  Returns -1 if it is not valid.
+ */
+int dm_parse(struct dmctx *c, char *spec);
+
+/*
+ * Finish setting up the formats (with the default formats,
+ * if none were given).  Returns -1 if they are not valid.
+ */
+int dm_ready(struct dmctx *c);
+
+/*
+ * The most bytes of output that one line can take.
+ * A buffer this big always has room for at least one line.
+ * It includes some room which dm_render uses for a copy of the line.
+ */
+size_t dm_linemax(struct dmctx *c);
+
+/*
+ * Print the len bytes at data, the first of which is at address addr,
+ * into the size bytes at buf.  As many whole lines are printed as fit;
+ * the last line may be short if data ends in the middle of it.
+ * Sets *usedp to the number of bytes of data printed,
+ * and returns the number of bytes of buf used, or -1 on error.
+ * The output is not nul terminated.
+ * addr is a long long, not an off_t, since the library is built with
+ * 64 bit file offsets and a program using it may not be.
+ */
+ssize_t dm_render(struct dmctx *c, unsigned char *data, size_t len, long long addr,
+	char *buf, size_t size, size_t *usedp);
+
+/*
+ * Print the header which comes before all the lines, if the
+ * output is machine readable (-T) and has one, into the size bytes
+ * at buf.  Returns the number of bytes of buf used, or -1 on error.
+ */
+ssize_t dm_header(struct dmctx *c, char *buf, size_t size);
+
+/*
+ * The message for the last error.
+ */
+char *dm_error(struct dmctx *c);
+
+void dm_free(struct dmctx *c);
@@ -0,0 +1,279 @@
+/*
+ * Machine readable output (-T): JSON Lines, CSV or packed binary.
+ *
+ * Each line of data becomes one record, with its address and the
+ * value of every item of every format which is printed: integers
+ * as plain decimal (signed if the format is), and characters as
+ * their codepoints, rather than padded text.
+ * The items of all the formats are set up as columns once,
+ * so printing a line is just a walk along the columns,
+ * with no allocation.
+ *
+ *   json  {"addr":16,"items":[[1,2,3,4],[97,98,99,100]]}
+ *         one array of values per format, in order.
+ *   csv   16,1,2,3,4,97,98,99,100
+ *         after a header line naming the columns: addr,f1_0,f1_1,...
+ *   bin   fixed size records, all numbers little-endian, packed:
+ *           u64 address, u32 bytes of data in the line,
+ *           then each column (a UTF-8 character is an s32).
+ *         The records follow a header:
+ *           "DMB1", u32 record size, u32 number of columns,
+ *           and for each column: u8 kind (COL_*), u8 size, u16 format.
+ * A value which the data does not reach (at the end of the file)
+ * is left out (json), empty (csv) or zero (bin).
+ * A UTF-8 format has a column for each byte: the codepoint of the
+ * character which starts there, or -1 for a continuation or
+ * malformed byte.
+ */
+
+#include "dm.h"
+
+/*
+ * Put the decimal digits of n just before end.
+ * Returns the start of the digits.
+ */
+	static char *
+decimal(char *end, u64 n, int neg)
+{
+	do {
+		*--end = '0' + (n % 10);
+		n /= 10;
+	} while (n != 0);
+	if (neg)
+		*--end = '-';
+	return (end);
+}
+
+/*
+ * Print a value in decimal.
+ */
+	static void
+prvalue(s64 v, int issigned)
+{
+	char buf[24];
+	char *end = buf + sizeof(buf);
+	char *s;
+
+	if (issigned && v < 0)
+		s = decimal(end, -(u64) v, 1);
+	else
+		s = decimal(end, (u64) v, 0);
+	prbytes(s, end - s);
+}
+
+/*
+ * Print n bytes of a value, little-endian.
+ */
+	static void
+prle(u64 v, int n)
+{
+	char buf[8];
+	int i;
+
+	for (i = 0;  i < n;  i++, v >>= 8)
+		buf[i] = (char) v;
+	prbytes(buf, n);
+}
+
+/*
+ * Add a column for an item of format fx (or of one of its fields).
+ */
+	static void
+addcol(struct dmctx *c, int fx, int item, struct format *f, int offset)
+{
+	struct column *col = &c->columns[c->ncolumns++];
+
+	col->fx = fx;
+	col->item = item;
+	col->offset = offset;
+	col->size = (f->size > 0) ? f->size : 1;
+	col->get = f->get;
+	if (f->flags & UTF_8)
+		col->kind = COL_UTF8;
+	else if (f->radix == 1 || (f->flags & ASCHAR))
+		col->kind = COL_CHAR;
+	else if (f->flags & SIGNED)
+		col->kind = COL_SIGNED;
+	else
+		col->kind = COL_UNSIGNED;
+}
+
+/*
+ * Size of a column in a binary record.
+ */
+	static int
+binsize(struct column *col)
+{
+	return ((col->kind == COL_UTF8) ? 4 : col->size);
+}
+
+/*
+ * Set up the columns of every format which is printed.
+ * Called once the render plans are set up.
+ * Returns -1 if out of memory.
+ */
+	int
+setcolumns(struct dmctx *c)
+{
+	int n = 0;
+	int fx;
+	int i;
+
+	for (fx = 0;  fx < c->nformat;  fx++) {
+		struct format *f = &c->format[fx];
+		if (f->flags & NOPRINT)
+			continue;
+		if (f->flags & RECORD)
+			n += f->nfields;
+		else
+			n += (f->size > 0) ? (c->count + f->size - 1) / f->size : c->count;
+	}
+	if ((c->columns = (struct column *) malloc((n + 1) * sizeof(struct column))) == NULL)
+		return (-1);
+	c->ncolumns = 0;
+	c->recsize = 8 + 4;
+	for (fx = 0;  fx < c->nformat;  fx++) {
+		struct format *f = &c->format[fx];
+		int item = 0;
+		if (f->flags & NOPRINT)
+			continue;
+		if (f->flags & RECORD) {
+			for (i = 0;  i < f->nfields;  i++)
+				if (!(f->fields[i].flags & NOPRINT))
+					addcol(c, fx, item++, &f->fields[i], f->fields[i].offset);
+		} else {
+			int psize = (f->size > 0) ? f->size : 1;
+			for (i = 0;  i < c->count;  i += psize)
+				addcol(c, fx, item++, f, i);
+		}
+	}
+	for (i = 0;  i < c->ncolumns;  i++)
+		c->recsize += binsize(&c->columns[i]);
+	return (0);
+}
+
+/*
+ * The most bytes the header can take.
+ */
+	size_t
+machheadmax(struct dmctx *c)
+{
+	/* A CSV column name is at most ",f" and two ints and "_". */
+	return (16 + c->ncolumns * 26);
+}
+
+/*
+ * Print the header which comes before the records, if any.
+ */
+	void
+machheader(struct dmctx *c)
+{
+	struct column *col;
+
+	switch (c->mode)
+	{
+	case OUT_CSV:
+		prstring("addr");
+		for (col = c->columns;  col < c->columns + c->ncolumns;  col++) {
+			prstring(",f");
+			prvalue(col->fx + 1, 0);
+			prstring("_");
+			prvalue(col->item, 0);
+		}
+		prstring("\n");
+		break;
+	case OUT_BIN:
+		prstring("DMB1");
+		prle(c->recsize, 4);
+		prle(c->ncolumns, 4);
+		for (col = c->columns;  col < c->columns + c->ncolumns;  col++) {
+			prle(col->kind, 1);
+			prle(binsize(col), 1);
+			prle(col->fx + 1, 2);
+		}
+		break;
+	}
+}
+
+/*
+ * Get the value of one column.
+ * Returns 0 if the data does not reach it.
+ */
+	static int
+getcol(struct column *col, u8 *line, size_t line_len, size_t avail, s64 *vp)
+{
+	if (col->kind == COL_UTF8) {
+		int usize;
+		int v;
+		if (col->offset >= line_len)
+			return (0);
+		usize = avail - col->offset;
+		v = utf8_value(line + col->offset, &usize);
+		*vp = (v < 0) ? -1 : v;
+		return (1);
+	}
+	if (col->offset + col->size > line_len)
+		return (0);
+	*vp = (s64) (*col->get)(line + col->offset);
+	if (col->kind == COL_SIGNED && col->size < 8)
+		/* Extend the sign bit. */
+		*vp = (s64) ((u64) *vp << (64 - 8*col->size)) >> (64 - 8*col->size);
+	return (1);
+}
+
+/*
+ * Print one line as a record.
+ * line has line_len bytes of the line, and avail bytes of data
+ * (including the lookahead) may be looked at.
+ */
+	void
+machline(struct dmctx *c, off_t addr, u8 *line, size_t line_len, size_t avail)
+{
+	struct column *col;
+	int fx = -1;
+	int sep = 0;
+	s64 v;
+
+	switch (c->mode)
+	{
+	case OUT_JSON:
+		prstring("{\"addr\":");
+		prvalue(addr, 0);
+		prstring(",\"items\":[");
+		for (col = c->columns;  col < c->columns + c->ncolumns;  col++) {
+			if (col->fx != fx) {
+				/* The first item of the next format. */
+				prstring((fx < 0) ? "[" : "],[");
+				fx = col->fx;
+				sep = 0;
+			}
+			if (!getcol(col, line, line_len, avail, &v))
+				continue;
+			if (sep)
+				prbytes(",", 1);
+			prvalue(v, col->kind != COL_UNSIGNED);
+			sep = 1;
+		}
+		prstring((fx < 0) ? "]}\n" : "]]}\n");
+		break;
+	case OUT_CSV:
+		prvalue(addr, 0);
+		for (col = c->columns;  col < c->columns + c->ncolumns;  col++) {
+			prbytes(",", 1);
+			if (getcol(col, line, line_len, avail, &v))
+				prvalue(v, col->kind != COL_UNSIGNED);
+		}
+		prstring("\n");
+		break;
+	case OUT_BIN:
+		prle(addr, 8);
+		prle(line_len, 4);
+		for (col = c->columns;  col < c->columns + c->ncolumns;  col++) {
+			if (!getcol(col, line, line_len, avail, &v))
+				v = 0;
+			prle(v, binsize(col));
+		}
+		break;
+	}
+	prendline();
+}
@@ -33,150 +33,299 @@
 #include <stdlib.h>
 #include "dm.h"
 
-extern int nformat;
-extern struct format format[];
-extern struct format aformat;
-extern int count;
-extern int verbose;
-extern off_t fileoffset;
+extern struct dmctx *dm;
+extern struct range *ranges;
+extern int nranges;
 extern int readoffset;
-extern int bigendian;
-extern int group_line;
+extern int showplan;
+extern int nthreads;
+extern char *manifest;
+extern char *outdir;
+extern int reverse;
+extern int follow;
+extern int diff;
+extern u8 *pattern;
+extern int stats;
+extern __thread struct stats tstats;
 
-	static int
-is_bigendian(void)
+/*
+ * Read a list of files to dump.
+ * Each line has a file name, optionally followed by
+ * an offset at which to start and a length to dump.
+ * Blank lines and lines starting with # are ignored.
+ */
+	static struct dumpjob *
+readmanifest(char *filename, long *pn)
 {
-	u32 one = 1;
-	return (*(u8*)&one != 1);
+	FILE *f;
+	char *line = NULL;
+	size_t linesize = 0;
+	struct dumpjob *jobs = NULL;
+	long n = 0;
+	long size = 0;
+	int lineno = 0;
+
+	if (strcmp(filename, "-") == 0)
+		f = stdin;
+	else if ((f = fopen(filename, "r")) == NULL) {
+		fprintf(stderr, "cannot open <%s>\n", filename);
+		exit(1);
+	}
+	while (getline(&line, &linesize, f) >= 0) {
+		char *words[4];
+		int nwords = 0;
+		int bad;
+		char *err;
+		char *w;
+		lineno++;
+		for (w = strtok(line, " \t\r\n");  w != NULL && nwords < 4;
+				w = strtok(NULL, " \t\r\n"))
+			words[nwords++] = w;
+		if (nwords == 0 || words[0][0] == '#')
+			continue;
+		if (n >= size) {
+			size = (size == 0) ? 64 : 2 * size;
+			if ((jobs = (struct dumpjob *) realloc(jobs, size * sizeof(*jobs))) == NULL)
+				panic("cannot allocate file list");
+		}
+		jobs[n].ranges = ranges;
+		jobs[n].nranges = nranges;
+		bad = (nwords > 3);
+		if (nwords > 1 && (jobs[n].ranges =
+				parseranges(&words[1], &jobs[n].nranges, &err)) == NULL)
+			bad = 1;
+		else if (nwords > 2 && jobs[n].nranges == 1 && jobs[n].ranges[0].end < 0 &&
+				getnum(&words[2], &jobs[n].ranges[0].length) < 0)
+			bad = 1;
+		if (bad || (nwords > 1 && *words[1] != '\0') ||
+				(nwords > 2 && *words[2] != '\0')) {
+			fprintf(stderr, "dm: bad line %d in %s\n", lineno, filename);
+			exit(1);
+		}
+		jobs[n].name = strdup(words[0]);
+		n++;
+	}
+	free(line);
+	if (f != stdin)
+		fclose(f);
+	*pn = n;
+	return (jobs);
 }
 
 	int
 main(int argc, char *argv[])
 {
-	bigendian = is_bigendian();
 	int arg = options(argc, argv);
-	if (nformat == 0) {
-		char *dm = getenv("DM");
-		if (dm != NULL) {
-			option(dm);
+	int status = 0;
+	if (dm->nformat == 0) {
+		char *env = getenv("DM");
+		if (env != NULL && dm_parse(dm, env) < 0)
+			usage(dm_error(dm));
+	}
+	/* With no formats, this sets up the default format. */
+	if (dm_ready(dm) < 0)
+		usage(dm_error(dm));
+	if (showplan) {
+		int fx;
+		fprintf(stderr, "address:  %s\n", dm->aformat.plan);
+		for (fx = 0;  fx < dm->nformat;  fx++)
+			fprintf(stderr, "format %d: %s\n", fx+1, dm->format[fx].plan);
+	}
+	if (follow && (arg > 1 || manifest != NULL))
+		usage("-t follows only one file");
+	if (follow && pattern != NULL)
+		usage("-t cannot be used with -g");
+	if (dm->mode != OUT_TEXT && (diff || reverse))
+		usage("-T cannot be used with -D or -R");
+	if (diff) {
+		/*
+		 * Compare two files.
+		 */
+		if (arg != 2)
+			usage("-D needs two files");
+		if (nranges > 0 || follow || reverse || pattern != NULL || manifest != NULL || outdir != NULL)
+			usage("-D compares whole files only");
+		status = difffiles(argv[argc-2], argv[argc-1]);
+		prflush();
+		exit((status < 0) ? 2 : status);
+	}
+	if (reverse) {
+		/*
+		 * Read dumps and write out the data.
+		 */
+		if (arg == 0)
+			status |= undumpfile("-");
+		else for (arg = argc - arg;  arg < argc;  arg++)
+			status |= undumpfile(argv[arg]);
+		prflush();
+		exit(status ? 1 : 0);
+	}
+	if (manifest != NULL || outdir != NULL || (nthreads > 1 && arg > 1)) {
+		/*
+		 * Dump a batch of files, several at a time.
+		 */
+		struct dumpjob *jobs;
+		long n;
+		if (manifest != NULL) {
+			jobs = readmanifest(manifest, &n);
 		} else {
-			/* Use default format. */
-			option("-xb");
-			option("+c");
+			long i;
+			n = (arg == 0) ? 1 : arg;
+			if ((jobs = (struct dumpjob *) malloc(n * sizeof(*jobs))) == NULL)
+				panic("cannot allocate file list");
+			for (i = 0;  i < n;  i++) {
+				jobs[i].name = (arg == 0) ? "-" : argv[argc - arg + i];
+				jobs[i].ranges = ranges;
+				jobs[i].nranges = nranges;
+			}
 		}
-	}
-	if (arg == 0)
+		status = dumpfiles(jobs, n, nthreads, outdir);
+	} else if (arg == 0)
 		/* Standard input */
-		dumpfile("-");
+		status = dumpfile("-", ranges, nranges, nthreads);
 	else for (arg = argc - arg;  arg < argc;  arg++)
-		dumpfile(argv[arg]);
+		status |= dumpfile(argv[arg], ranges, nranges, nthreads);
 
-	exit(0);
+	prflush();
+	exit(status ? 1 : 0);
 }
 
 /*
- * Dump an entire file.
+ * Dump one range of a file, from in->addr to in->end.
  */
-	void
-dumpfile(char *filename)
+	static void
+dumprange(struct input *in, int threads)
 {
-	FILE *f;
-	size_t last_len = 0;
-	size_t rextra = 6;
-	int didstar = 0;
-	off_t addr;
-	off_t firstaddr;
-	char buf[MAXLINESIZE];
-	char lastbuf[MAXLINESIZE];
-
-	if (strcmp(filename, "-") == 0) {
-		/* Standard input */
-		f = stdin;
-		filename = "standard input";
-	} else if ((f = fopen(filename, "rb")) == NULL) {
-		fprintf(stderr, "cannot open <%s>\n", filename);
-		return;
-	}
+	struct dumpstate st;
+	off_t addr = in->addr;
+	off_t hstart = -1;  /* The next hole in the file */
+	off_t hend = -1;
+	int holes = !dm->verbose;
+	int count = dm->count;
+	size_t shown = 0;   /* Length of a short last line shown by -t */
 
-	/*
-	 * Advance to the proper file offset.
-	 * We do this one of two ways:
-	 *  by reading the file until we reach the desired offset,
-	 *  or by seeking directly to the desired offset.
-	 */
-	if (fileoffset == 0) {
-		/* No need to advance. */
-		addr = 0;
-	} else if (readoffset) {
-		/* Advance by reading. */
-		size_t len = 0;
-		for (addr = 0;  addr < fileoffset;  addr += len) {
-			len = (size_t) (fileoffset - addr);
-			if (len > sizeof(buf))
-				len = sizeof(buf);
-			len = fread(buf, sizeof(char), len, f);
-			if (len <= 0) {
-				fprintf(stderr, "cannot read to %ld in %s\n",
-					(long) fileoffset, filename);
-				return;
-			}
-		}
+	if (threads > 1 && in->map != NULL) {
+		/* The whole file is in memory; dump pieces of it in parallel. */
+		addr = dumpchunks(in->data, in_fill(in, 0), addr, threads);
 	} else {
-		/* Advance by seeking. */
-		if (fseek(f, (long) fileoffset, 0)) {
-			fprintf(stderr, "cannot seek to %ld in %s\n",
-				(long) fileoffset, filename);
-			return;
+		st.firstaddr = addr;
+		st.last_len = 0;
+		st.didstar = 0;
+		for (;;) {
+			size_t avail = in_fill(in, count + LOOKAHEAD);
+			off_t skip;
+			if (follow && avail < (size_t) count && in->end < 0) {
+				/*
+				 * At the end of a file we are following.
+				 * Show the short last line (if it has grown),
+				 * and wait for more data.
+				 */
+				if (avail > shown) {
+					dumpline(dm, &st, addr, in->data, avail);
+					shown = avail;
+				}
+				prflush();
+				if (in_wait(in) == 0)
+					continue;
+				if (shown > 0)
+					addr += count;
+				break;
+			}
+			if (avail == 0) break;
+			if (shown > 0) {
+				/*
+				 * Show the line again now that it is complete,
+				 * even if it is a duplicate.
+				 */
+				off_t first = st.firstaddr;
+				st.firstaddr = addr;
+				dumpline(dm, &st, addr, in->data, avail);
+				st.firstaddr = first;
+				shown = 0;
+			} else
+				dumpline(dm, &st, addr, in->data, avail);
+			if (st.didstar && holes && addr >= hend &&
+					in_hole(in, addr, &hstart, &hend) < 0)
+				holes = 0;
+			skip = count;
+			if (st.didstar && holes && addr >= hstart && addr + count <= hend) {
+				/*
+				 * This line is a duplicate in a hole.
+				 * Every following line in the hole is a duplicate
+				 * too, so go to the first line which is not
+				 * entirely in the hole without reading them.
+				 */
+				off_t end = (in->end >= 0 && hend > in->end) ? in->end : hend;
+				if (end - addr > count)
+					skip = ((end - addr) / count) * count;
+			}
+			if (skip > count) {
+				in_skiphole(in, skip);
+				tstats.holebytes += skip - count;
+			} else {
+				in_advance(in, count);
+			}
+			addr += skip;
+			if (stats)
+				stat_progress(in, addr, 0);
 		}
-		addr = fileoffset;
+		if (stats)
+			stat_progress(in, addr, 1);
 	}
+	if (dm->mode != OUT_TEXT)
+		/* Records have no final address. */
+		return;
+	/* Print the final address. */
+	printbuf(&dm->aformat, (u8*) &addr, sizeof(addr), sizeof(addr), sizeof(addr));
+	prstring("\n");
+	prendline();
+}
 
-	firstaddr = addr;
-	size_t bufdata = 0;
-	for (;; addr += count) {
-		if (bufdata < count) {
-			bufdata = 0;
-		} else {
-			memmove(buf, buf+count, bufdata-count);
-			bufdata -= count;
+/*
+ * Dump some ranges of a file (or all of it, if nranges is 0).
+ * Each range starts afresh, with its own final address.
+ * Returns -1 if the file cannot be dumped at all,
+ * or its decompressor fails.
+ */
+	int
+dumpfile(char *filename, struct range *ranges, int nranges, int threads)
+{
+	static struct range all = { 0, -1, -1 };
+	struct input in;
+	int i;
+
+	if (nranges == 0) {
+		ranges = &all;
+		nranges = 1;
+	}
+	if (in_open(&in, filename, (pattern != NULL) ? searchhist() : dm->count,
+			!readoffset && !follow) < 0)
+		return (-1);
+	machheader(dm);
+	for (i = 0;  i < nranges;  i++) {
+		struct range *r = &ranges[i];
+		off_t start = r->start;
+		off_t length = r->length;
+		if (start < 0) {
+			/* Count back from the end of the file. */
+			off_t size = in_size(&in);
+			if (size < 0) {
+				fprintf(stderr, "cannot find the end of %s\n", in.name);
+				in_close(&in);
+				return (-1);
+			}
+			start = (size + start < 0) ? 0 : size + start;
 		}
-		ssize_t nread = fread(buf + bufdata, sizeof(char), count + rextra - bufdata, f);
-		if (nread < 0) break;
-		bufdata += nread;
-		if (bufdata == 0) break;
-		/* Fill the unused bytes with 0. */
-		if (bufdata < count)
-			memset(&buf[bufdata], 0, count-bufdata);
-		/* line_len is amount to print on this line.
-		 * Normally line_len==count unless there is not enough data in buf. */
-		size_t line_len = bufdata;
-		if (line_len > count) line_len = count;
-		/* Duplicate of the previous line? */
-		if (!verbose && addr != firstaddr && 
-				line_len == last_len && eqbuf(buf, lastbuf, line_len)) {
-			/* Just print an asterisk (unless we've already done so). */
-			if (!didstar)
-				prstring("*\n");
-			didstar = 1;
-			continue;
+		if (r->end >= 0)
+			length = (r->end > start) ? r->end - start : 0;
+		if (in_seek(&in, start, length, readoffset) < 0) {
+			in_close(&in);
+			return (-1);
 		}
-		didstar = 0;
-		last_len = line_len;
-		/* Remember the current buffer. */
-		memcpy(lastbuf, buf, line_len);
-
-		/* Print the address, in the address format. */
-		printbuf(&aformat, (u8*) &addr, sizeof(addr), sizeof(addr), sizeof(addr));
-
-		/* Print the data, in all formats. */
-		int fx;
-		for (fx = 0;  fx < nformat;  fx++)
-			printbuf(&format[fx], (u8*) buf, count, line_len, bufdata);
-		if (group_line)
-			prstring("\n");
+		if (pattern != NULL)
+			searchrange(&in);
+		else
+			dumprange(&in, threads);
 	}
-	/* Print the final address. */
-	printbuf(&aformat, (u8*) &addr, sizeof(addr), sizeof(addr), sizeof(addr));
-	prstring("\n");
-	fclose(f);
+	return (in_close(&in));
 }
@@ -0,0 +1,107 @@
+/*
+ * mkuprop - compile the Unicode range tables into a lookup table.
+ *
+ * The *.uni files list ranges of codepoints which have some property
+ * (combining, format, binary, wide, ...).  Looking a character up
+ * in each of them takes several binary searches, so this program
+ * (run when dm is built) combines them into a two-stage table:
+ * uprop_index[ch >> 8] selects a block of 256 property bytes, and
+ * the low 8 bits of ch select the byte within the block.
+ * Identical blocks are stored only once.
+ * The output is C source, written to the standard output.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "dm.h"
+
+struct wchar_range { unsigned long first, last; };
+
+static struct wchar_range compose_array[] = {
+#include "compose.uni"
+};
+static struct wchar_range fmt_array[] = {
+#include "fmt.uni"
+};
+static struct wchar_range ubin_array[] = {
+#include "ubin.uni"
+};
+static struct wchar_range wide_array[] = {
+#include "wide.uni"
+};
+static struct wchar_range comb_array[] = {
+#include "comb.uni"
+};
+
+#define NCHARS   0x110000
+#define NBLOCKS  (NCHARS >> 8)
+
+static u8 props[NCHARS];
+static int blockof[NBLOCKS];
+
+	static void
+setprop(struct wchar_range *table, int count, int bit)
+{
+	int i;
+	unsigned long ch;
+
+	for (i = 0;  i < count;  i++)
+		for (ch = table[i].first;  ch <= table[i].last && ch < NCHARS;  ch++)
+			props[ch] |= bit;
+}
+
+#define SETPROP(name, bit) \
+	setprop(name##_array, sizeof(name##_array)/sizeof(*name##_array), bit)
+
+	int
+main(int argc, char *argv[])
+{
+	int nblocks = 0;
+	int b, i;
+	unsigned long ch;
+
+	SETPROP(compose, UP_COMPOSE);
+	SETPROP(fmt, UP_FMT);
+	SETPROP(ubin, UP_BIN);
+	SETPROP(wide, UP_WIDE);
+	SETPROP(comb, UP_COMB);
+	for (ch = 0;  ch < NCHARS;  ch++)
+		if (ch >= 0x20 && !(props[ch] & (UP_COMPOSE|UP_FMT|UP_BIN|UP_COMB)))
+			props[ch] |= UP_PRINT;
+
+	printf("/* Generated by \"./mkuprop\" from compose.uni fmt.uni ubin.uni wide.uni comb.uni */\n");
+	printf("#include \"dm.h\"\n\n");
+	printf("const u8 uprop_blocks[][256] = {\n");
+	for (b = 0;  b < NBLOCKS;  b++) {
+		/* Use an earlier block if it is the same as this one. */
+		for (i = 0;  i < b;  i++)
+			if (blockof[i] == i && memcmp(&props[i << 8], &props[b << 8], 256) == 0)
+				break;
+		if (i < b) {
+			blockof[b] = i;
+			continue;
+		}
+		blockof[b] = b;
+		printf("\t{ /* block %d: 0x%04x */\n", nblocks, b << 8);
+		for (i = 0;  i < 256;  i++)
+			printf("%s0x%02x,%s", (i % 16 == 0) ? "\t\t" : " ",
+				props[(b << 8) + i], (i % 16 == 15) ? "\n" : "");
+		printf("\t},\n");
+		nblocks++;
+	}
+	printf("};\n\n");
+
+	printf("const u16 uprop_index[%d] = {\n", NBLOCKS);
+	{
+		/* Renumber the blocks in the order they were printed. */
+		int num[NBLOCKS];
+		int n = 0;
+		for (b = 0;  b < NBLOCKS;  b++)
+			num[b] = (blockof[b] == b) ? n++ : num[blockof[b]];
+		for (b = 0;  b < NBLOCKS;  b++)
+			printf("%s%d,%s", (b % 16 == 0) ? "\t" : " ",
+				num[b], (b % 16 == 15) ? "\n" : "");
+	}
+	printf("};\n");
+	return (0);
+}
@@ -5,609 +5,243 @@
 #include <stdio.h>
 #include "dm.h"
 
-struct format format[NFORMAT];  /* All data formats */
-struct format aformat;          /* Address format */
-int nformat = 0;                /* Number of formats in format[] */
-int count = 16;                 /* Count of bytes per line */
-int verbose = 0;                /* Show all data */
-long fileoffset = 0L;           /* Starting offset in the input file */
-int readoffset = 0;             /* Read rather than seek to fileoffset */
-int bigendian = 0;
-int color = 0;                  /* Color the output */
-int group_line = 0;             /* Extra newline after each line group */
-
-/*
- * The "default" format.
- * Default format is used for any unspecified attributes of a format.
- * Various parts of the default format may be changed by a -- option.
- */
-static struct format def = {
-	NULL, NULL,
-	0,   /* Default flags = (none) */
-	16,  /* Default radix = hex */
-	1,   /* Default size = byte */
-	0,   /* width */
-	0,   /* zwidth */
-	0,   /* comma */
-	0    /* col */
-};
-
-static char addrtab[64];
-
-/* usage error messages */
-char DUP_SIZE[] =  "more than one SIZE option in a format";
-char DUP_RADIX[] = "more than one RADIX option in a format";
-
-static void adjcol(void);
-static void setaddrtab(void);
-static void fixaformat(void);
+struct dmctx *dm;               /* The formats */
+struct range *ranges = NULL;    /* Parts of the input file to dump */
+int nranges = 0;                /* Number of ranges (0 means all) */
+int readoffset = 0;             /* Read rather than seek to each range */
+int showplan = 0;               /* Describe the render plan of each format */
+int nthreads = 1;               /* Number of threads to dump with */
+char *manifest = NULL;          /* File listing the files to dump */
+char *outdir = NULL;            /* Directory for a separate dump of each file */
+int reverse = 0;                /* Read a dump and write the data */
+int follow = 0;                 /* Keep dumping data appended to the file */
+int diff = 0;                   /* Dump only the lines where two files differ */
+u8 *pattern = NULL;             /* Dump only the lines around this */
+size_t patlen = 0;              /* Length of pattern */
+int context = 0;                /* Lines to dump before and after a match */
+
+extern int decompress;
+
+static void option(char *s);
+static void getpattern(char *s);
 static int getint(char **ss);
-static long getlong(char **ss);
 
 /*
  * Parse command line options.
+ * The options which set up formats are handed to dm_parse();
+ * the rest control what is dumped, and how.
  */
 	int
 options(int argc, char *argv[])
 {
 	char *s;
 
+	if ((dm = dm_new()) == NULL)
+		panic("cannot allocate context");
 	while (--argc > 0) {
 		s = *++argv;
 		if (*s != '-' && *s != '+')
 			break;
-		/*
-		 * Special case: if first option starts with +,
-		 * pretend there is an empty option before it.
-		 * This will set up the default format first, then
-		 * append the format specified by the + option.
-		 */
-		if (*s == '+' && nformat == 0)
-			option("-");
+		if (strcmp(s, "--stats") == 0) {
+			/* Not a "--" default format. */
+			stat_start(dm);
+			continue;
+		}
 		option(s);
 	}
-
-	fixaformat();
-	setaddrtab();
-	adjcol();
-
 	return (argc);
 }
 
-/*
- * Initialize the address format.
- * It may already be partially initialized by a -a option.
- */
-	static void
-fixaformat(void)
-{
-	aformat.size = sizeof(off_t);
-	aformat.after = ": ";
-	aformat.inter = "";
-
-	if (aformat.radix == 0)
-		aformat.radix = def.radix;
-	if (aformat.comma == 0)
-		aformat.comma = def.comma;
-
-	/*
-	 * Keep only the flags which are meaningful for addresses.
-	 */
-	aformat.flags |= def.flags;
-	aformat.flags &= NOPRINT|LEFTJUST|ZEROPAD|UPPERCASE|DOTCOMMA;
-
-	/*
-	 * Set up the width and zwidth.
-	 */
-	aformat.zwidth = defwidth(aformat.radix, aformat.size, aformat.comma);
-	if (aformat.width == 0)
-		aformat.width = aformat.zwidth;
-	if (aformat.width > 10) aformat.width = 10; // FIXME??
-	if (aformat.zwidth > aformat.width)
-		aformat.zwidth = aformat.width;
-}
-
 /*
  * Parse a single command line option.
- * A single option generally sets up a single data format.
- * Exceptions are some options like -n which don't apply to data formats;
- * -a which sets up the address format;
- * and -- which sets up defaults for all subsequent formats.
  */
-	void
+	static void
 option(char *s)
 {
-	struct format *f;
-	int size;
-	int radix;
-	int flags;
-	int addr;
-	int width;
-	int zwidth;
-	int comma;
-	char optchar = '\0';
-	char *after;
-	char *inter;
-
-	if (*s == '-' || *s == '+') {
-		optchar = *s++;
-		if (optchar == '-' && *s == '-') {
-			/*
-			 * Option starts with double "-".
-			 */
-			optchar = '=';
-			s++;
-		}
-	}
-	flags = 0;
-	size = 0;
-	radix = 0;
-	width = 0;
-	comma = 0;
-	after = NULL;
-	inter = NULL;
-	addr = 0;
-
-	while (*s != '\0')  switch (*s++)
+	if (s[0] == '-') switch (s[1])
 	{
-	case 'a': /* Applies to address, not data */
-		addr = 1;
-		break;
-	case 'b': /* 8 bit size */
-		if (size)
-			usage(DUP_SIZE);
-		size = 1;
-		break;
-	case 'c': /* Character (ASCII) */
-		if (size)
-			usage(DUP_SIZE);
-		if (radix)
-			usage(DUP_RADIX);
-		radix = 1;
-		size = 1;
-		inter = "";
-		break;
-	case 'C': /* Character (expanded ASCII) */
-		if (size)
-			usage(DUP_SIZE);
-		size = 1;
-		flags |= ASCHAR;
-		break;
-	case 'd': /* Radix 10 (decimal) */
-		if (radix)
-			usage(DUP_RADIX);
-		radix = 10;
-		break;
-	case 'E':
-		group_line = 1;
-		break;
-	case 'e': /* Print C style escape sequences for characters */
-		flags |= CSTYLE;
-		break;
+	case 'D': /* Diff two files */
+		diff = 1;
+		return;
 	case 'F': /* Set initial file offset */
 		readoffset = 1;
 		/* FALLTHRU */
 	case 'f': /* Set initial file offset */
-		fileoffset = getlong(&s);
+		s += 2;
+		free(ranges);
+		ranges = getranges(&s, &nranges);
 		if (*s != '\0')
 			usage("extra characters in -f option");
 		return;
-	case 'j': /* Left justify */
-		flags |= LEFTJUST;
-		break;
-	case 'k': /* Use color */
-		color = 1;
-		break;
-	case 'l': /* 32 bit size */
-		if (size)
-			usage(DUP_SIZE);
-		size = 4;
-		break;
-	case 'L': /* 64 bit size */
-		if (size)
-			usage(DUP_SIZE);
-		size = 8;
-		break;
-	case 'm': /* Mnemonic ASCII */
-		flags |= MNEMONIC;
-		break;
-	case 'n': /* Set count (bytes per line) */
-		count = getint(&s);
+	case 'g': /* Search for a pattern */
+		getpattern(s+2);
+		return;
+	case 'G': /* Set lines of context around a match */
+		s += 2;
+		context = getint(&s);
+		if (*s != '\0' || context < 0)
+			usage("illegal value for -G option");
+		return;
+	case 'J': /* Set number of threads */
+		s += 2;
+		nthreads = getint(&s);
 		if (*s != '\0')
-			usage("extra characters in -n option");
-		if (count < 1 || count > MAXLINESIZE)
-			usage("illegal value for -n option");
+			usage("extra characters in -J option");
+		if (nthreads < 1)
+			usage("illegal value for -J option");
+		return;
+	case 'M': /* Read list of files to dump */
+		if (s[2] == '\0')
+			usage("missing file name in -M option");
+		manifest = s+2;
 		return;
-	case 'N': /* Don't print; useful with -a */
-		flags |= NOPRINT;
-		break;
-	case 'o': /* Radix 8 (octal) */
-		if (radix)
-			usage(DUP_RADIX);
-		radix = 8;
-		break;
-	case 'p': /* Set printing width */
-		width = getint(&s);
-		break;
-	case 'q':
-		flags |= DM_LITTLE_ENDIAN;
-		break;
-	case 'Q':
-		flags |= DM_BIG_ENDIAN;
-		break;
-	case 'r': /* Set arbitrary radix */
-		if (radix)
-			usage(DUP_RADIX);
-		radix = getint(&s);
-		if (radix < 2 || radix > 36)
-			usage("invalid radix");
-		break;
-	case 's': /* Signed numbers */
-		flags |= SIGNED;
-		break;
-	case 'X': /* Use uppercase for alphabetic digits */
-		flags |= UPPERCASE;
-		break;
-	case 'u': /* UTF-8 chars */
-		if (size)
-			usage(DUP_SIZE);
-		if (radix)
-			usage(DUP_RADIX);
-		radix = 1;
-		size = -1; // variable size
-		inter = "";
-		flags |= UTF_8;
-		break;
-	case 'U': /* UTF-8 codepoints */
-		if (size)
-			usage(DUP_SIZE);
-		size = -1; // variable size
-		flags |= UTF_8|ASCHAR;
-		break;
-	case 'v':
-		verbose = 1;
+	case 'O': /* Dump each file into its own file */
+		if (s[2] == '\0')
+			usage("missing directory name in -O option");
+		outdir = s+2;
+		return;
+	case 'P': /* Describe render plans */
+		showplan = 1;
+		return;
+	case 'R': /* Reverse: read a dump */
+		reverse = 1;
+		return;
+	case 't': /* Follow a growing file */
+		follow = 1;
 		return;
 	case 'V':
 		printf("dm version %s\n", version);
 		exit(0);
-	case 'w': /* 16 bit size */
-		if (size)
-			usage(DUP_SIZE);
-		size = 2;
-		break;
-	case 'x': /* Radix 16 (hex) */
-		if (radix)
-			usage(DUP_RADIX);
-		radix = 16;
-		break;
-	case 'z': /* Zero pad */
-		flags |= ZEROPAD;
-		break;
-	case '.':
-		flags |= DOTCOMMA;
-		/* fall thru */
-	case ',':
-		comma = getint(&s);
-		break;
+	case 'Z': /* Don't decompress */
+		decompress = 0;
+		return;
 	case '?':
 		usage(NULL);
-	default:
-{ char buf[64]; snprintf(buf, sizeof(buf), "illegal option letter -%c", s[-1]); usage(buf); }
 	}
-	if (radix == 0)
-		radix = 16;
-	else if ((flags & (UTF_8|ASCHAR)) == (UTF_8|ASCHAR)) // specified -U and a radix
-		flags |= DM_CODEPT;
-
-	if (optchar == '=') {
-		/*
-		 * The option started with "--".
-		 * Just change some defaults; don't set up a format.
-		 */
-		if (addr)
-			usage("cannot use -a in a default (--) option");
-		if (width != 0)
-			usage("cannot set default for -p");
-		if (size != 0)
-			def.size = size;
-		if (radix != 0)
-			def.radix = radix;
-		if (flags != 0)
-			def.flags = flags;
-		if (comma != 0)
-			def.comma = comma;
-		return;
-	}
-
-	/*
-	 * Set up the format structure.
-	 */
-	if (addr) {
-		/*
-		 * Don't fill in any defaults for the address format.
-		 * We take care of that later, in fixaformat().
-		 */
-		f = &aformat;
-		if (radix == 1 || (flags & (ASCHAR|UTF_8|MNEMONIC|CSTYLE)))
-			usage("invalid option used with -a");
-		zwidth = 0;
-	} else {
-		/*
-		 * Fill in defaults for anything not specified.
-		 */
-		if (size == 0)
-			size = def.size;
-		if (radix == 0)
-			radix = def.radix;
-		if (comma == 0)
-			comma = def.comma;
-		flags |= def.flags;
-		if (radix == 1 || (flags & (ASCHAR|UTF_8)))
-			flags &= ~SIGNED;
-		if (after == NULL)
-			after = "\n";
-		if (inter == NULL)
-			inter = " ";
-		zwidth = defwidth(radix, size, comma);
-		if (width == 0) {
-			/*
-			 * Set up printing width to be just big enough to
-			 * hold the widest string we'll ever need to print.
-			 */
-			width = defwidth(radix, size, comma);
-			if (flags & SIGNED)
-				/* Add one for a possible minus sign. */
-				width++;
-			if ((flags & (ASCHAR|MNEMONIC)) == (ASCHAR|MNEMONIC) &&
-				width < 3)
-				/*
-				 * Need at least 3 printing positions to
-				 * display ASCII mnemonics.
-				 */
-				zwidth = width = 3;
-			if ((flags & (ASCHAR|CSTYLE)) == (ASCHAR|CSTYLE) &&
-				width < 2)
-				/*
-				 * Need at least 2 printing positions to
-				 * display C style mnemonics.
-				 */
-				zwidth = width = 2;
-		}
-
-		/*
-		 * Figure out the column for this format.
-		 *
-		 * This is a "logical column" assigned as follows:
-		 * The first format on each line is column 0.
-		 * Any format immediately to the right of a column 0
-		 * format is column 1, and so on.
-		 */
-		if (nformat == 0) {
-			/*
-			 * The column of the first format must be 0.
-			 */
-			format[nformat].col = 0;
-		} else if (optchar == '+') {
-			/*
-			 * Display NEXT TO the previous format.
-			 * Set the previous format's "after" string
-			 * to spaces, and set our column to one more 
-			 * than the previous format's column.
-			 */
-			format[nformat-1].after = "   ";
-			format[nformat].col = format[nformat-1].col + 1;
-		} else {
-			/*
-			 * Display UNDER the previous format
-			 * (that is, at the start of the next line).
-			 * Set the previous format's "after" string
-			 * to a newline and some spaces, and set
-			 * our column to 0.
-			 */
-			format[nformat-1].after = addrtab;
-			format[nformat].col = 0;
-		}
-		f = &format[nformat++];
-		if (nformat > NFORMAT)
-			usage("too many formats");
-	}
-
-	/*
-	 * Set up the new format structure.
-	 */
-	f->radix = radix;
-	f->size = size;
-	f->width = width;
-	f->zwidth = zwidth;
-	f->flags = flags;
-	f->comma = comma;
-	f->after = after;
-	f->inter = inter;
+	if (dm_parse(dm, s) < 0)
+		usage(dm_error(dm));
 }
 
 /*
- * Set up the addrtab string.
- * addrtab is used as the "after" string of the last format 
- * in a printable line, to print a newline followed by enough
- * spaces to tab past the address displayed on the first line.
+ * Parse an integer.
  */
-	static void
-setaddrtab(void)
+	off_t
+getoffset(char **ss)
 {
-	int width;
-	int i;
+	off_t n;
 
-	addrtab[0] = '\n';
-	/*
-	 * Append enough spaces to equal the width of the address.
-	 */
-	width = aformat.width + strlen(aformat.after);
-	for (i = 0;  i < width;  i++)
-		addrtab[i+1] = ' ';
-	addrtab[i+1] = '\0';
+	if (getnum(ss, &n) < 0)
+		usage("missing number");
+	return (n);
 }
 
+	static int
+getint(char **ss)
+{
+	return ((int) getoffset(ss));
+}
 
 /*
- * Adjust the width (printable size) of each format
- * to make the columns line up nicely.
+ * Parse a list of ranges, separated by commas.
+ * Each range is an offset, optionally followed by
+ * "+length" or "-end" (where end is the offset after the range).
+ * An offset starting with "-" counts back from the end of the file.
+ * Sets *np to the number of ranges.
+ * Returns NULL, with the reason in *errp, if the list is not valid.
  */
-	static void
-adjcol(void)
+	struct range *
+parseranges(char **ss, int *np, char **errp)
 {
-	int col;
-	struct format *f;
-	int found;
-	int minsize;
-	int maxwidth8;
-	int width8;
-
-	for (col = 0; ; col++) {
-		/*
-		 * Find the smallest size and the largest width in this column.
-		 * Actually, we don't look at the width, but the width8:
-		 * the printable width of 8 bytes of data (whereas
-		 * width is the printable size of "size" bytes of data).
-		 * This lets us compare formats which have different sizes.
-		 * We also count any trailing space (f->inter) in the width8.
-		 */
-		found = 0;
-		minsize = 8;
-		maxwidth8 = 0;
-
-		for (f = format;  f < &format[nformat];  f++)
-			if (f->col == col) {
-				int psize = (f->size > 0) ? f->size : 1;
-				found++;
-				if (psize < minsize)
-					minsize = psize;
-				width8 = (8 / psize) * 
-						(f->width + strlen(f->inter));
-				if (width8 > maxwidth8)
-					maxwidth8 = width8;
-			}
-
-		if (!found)
-			/*
-			 * Nothing in this column; we're done.
-			 */
-			return;
-
-		/*
-		 * Now round up the max width8 to be divisible into
-		 * pieces as required by the min size.
-		 */
-		minsize = 8 / minsize;
-		maxwidth8 = (maxwidth8 + minsize - 1) / minsize;
-		maxwidth8 *= minsize;
-
-		/*
-		 * Run thru again, adjusting (rounding up) the width
-		 * for each format in this column.
-		 */
-		for (f = format;  f < &format[nformat];  f++) {
-			int psize = (f->size > 0) ? f->size : 1;
-			if (f->col == col) {
-				width8 = 8 / psize;
-				f->width = (maxwidth8 / width8) - 
-						strlen(f->inter);
-				if (strlen(f->inter) == 0 && f->width > 1) {
-					/*
-					 * Ugly kludge to handle characters:
-					 * Normally, -c format has the inter
-					 * string empty and width == 1.
-					 * If we have adjusted the width to
-					 * be > 1, then use the inter string
-					 * for one of the spaces.
-					 * This makes the chars line up
-					 * better with other formats.
-					 */
-					f->inter = " ";
-					f->width--;
-				}
+	char *s = *ss;
+	struct range *r = NULL;
+	int n = 0;
+
+	for (;;) {
+		int fromend = 0;
+		if ((r = (struct range *) realloc(r, (n+1) * sizeof(*r))) == NULL)
+			panic("cannot allocate ranges");
+		if (*s == '-') {
+			s++;
+			fromend = 1;
+		}
+		if (getnum(&s, &r[n].start) < 0)
+			goto bad;
+		if (fromend)
+			r[n].start = -r[n].start;
+		r[n].length = r[n].end = -1;
+		if (*s == '+') {
+			s++;
+			if (getnum(&s, &r[n].length) < 0)
+				goto bad;
+		} else if (*s == '-') {
+			s++;
+			if (getnum(&s, &r[n].end) < 0)
+				goto bad;
+			if (!fromend && r[n].end < r[n].start) {
+				*errp = "range ends before it starts";
+				free(r);
+				return (NULL);
 			}
 		}
+		n++;
+		if (*s != ',')
+			break;
+		s++;
 	}
+	*ss = s;
+	*np = n;
+	return (r);
+bad:
+	*errp = "missing number";
+	free(r);
+	return (NULL);
 }
 
 /*
- * Get the value of a single digit of an integer.
+ * Parse a list of ranges in an option.
  */
-	static int
-gdigit(int ch)
+	struct range *
+getranges(char **ss, int *np)
 {
-	if (ch >= '0' && ch <= '9')
-		return (ch - '0');
-	if (ch >= 'a' && ch <= 'f')
-		return (ch - 'a' + 10);
-	if (ch >= 'A' && ch <= 'F')
-		return (ch - 'A' + 10);
-	return (-1);
+	struct range *r;
+	char *err;
+
+	if ((r = parseranges(ss, np, &err)) == NULL)
+		usage(err);
+	return (r);
 }
 
 /*
- * Parse an integer.
+ * Parse a search pattern: hex bytes after "0x", or else a string.
  */
-	static long
-getlong(char **ss)
+	static void
+getpattern(char *s)
 {
-	char *s = *ss;
-	long n;
-	int radix;
-	int v;
-
-	/*
-	 * Default radix is decimal.
-	 */
-	radix = 10;
-
-	if (*s == '0' && s[1] != '\0') {
-		/*
-		 * If it starts with a 0, we use an alternate radix.
-		 * Plain zero means octal.  0x means hex.
-		 */
-		s++;
-		radix = 8;
-		if (*s == 'x' || *s == 'X') {
-			s++;
-			radix = 16;
+	size_t n = strlen(s);
+
+	if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+		s += 2;
+		n = strlen(s);
+		if (n == 0 || n % 2 != 0)
+			usage("-g hex pattern needs pairs of digits");
+		patlen = n / 2;
+		if ((pattern = (u8 *) malloc(patlen)) == NULL)
+			panic("cannot allocate pattern");
+		for (n = 0;  n < patlen;  n++) {
+			int hi = gdigit(s[2*n]);
+			int lo = gdigit(s[2*n+1]);
+			if (hi < 0 || lo < 0)
+				usage("bad hex digit in -g pattern");
+			pattern[n] = (hi << 4) | lo;
 		}
+	} else {
+		if (n == 0)
+			usage("empty -g pattern");
+		pattern = (u8 *) strdup(s);
+		patlen = n;
 	}
-
-	/*
-	 * Parse the digits of the number.
-	 */
-	n = 0;
-	while ((v = gdigit(*s)) >= 0 && v < radix) {
-		n = (radix * n) + v;
-		s++;
-	}
-	if (s == *ss)
-		usage("missing number");
-
-	/*
-	 * Followed by "k" means multiply by 1024,
-	 * "m" means multiply by 1024*1024, and
-	 * "g" means multiply by 1024*1024*1024.
-	 */
-	if (*s == 'k' || *s == 'K') {
-		s++;
-		n *= 1024;
-	} else if (*s == 'm' || *s == 'M') {
-		s++;
-		n *= 1024*1024;
-	} else if (*s == 'g' || *s == 'G') {
-		s++;
-		n *= 1024*1024*1024;
-	}
-	*ss = s;
-	return (n);
-}
-
-	static int
-getint(char **ss)
-{
-	return ((int) getlong(ss));
+	if (patlen > MAXPATTERN)
+		usage("-g pattern is too long");
 }
 
 	void
@@ -616,18 +250,32 @@ usage(char *s)
 	if (s != NULL)
 		fprintf(stderr, "dm: %s\n", s);
 
-	fprintf(stderr, "usage: dm [-n#][-v][-E][-f#][-F#][-V] [-a<fmt>] [[-+]<fmt>]... [file]...\n");
+	fprintf(stderr, "usage: dm [-n#][-v][-D][-E][-f#][-F#][-g<pat>][-G#][-J#][-M<file>][-O<dir>][-P][-R][-t][-T<mode>][-V][-Z][--stats] [-a<fmt>] [[-+]<fmt>]... [file]...\n");
 	fprintf(stderr, "      -n#      bytes per line\n");
 	fprintf(stderr, "      -v       don't skip repeated lines\n");
+	fprintf(stderr, "      -D       dump only the lines where two files differ\n");
 	fprintf(stderr, "      -E       print extra newline to separate line groups\n");
 	fprintf(stderr, "      -f#      skip to offset #\n");
 	fprintf(stderr, "      -F#      seek to offset #\n");
+	fprintf(stderr, "               # may be a list of ranges: #,#+len,#-end,-#\n");
+	fprintf(stderr, "      -g<pat>  dump only lines around each match of <pat>\n");
+	fprintf(stderr, "               (a string, or hex bytes after 0x)\n");
+	fprintf(stderr, "      -G#      dump # lines of context around each match\n");
 	fprintf(stderr, "      +<fmt>   print on same line\n");
 	fprintf(stderr, "      -<fmt>   print on new line\n");
 	fprintf(stderr, "      -a<fmt>  format of addresses\n");
 	fprintf(stderr, "      -aN      suppress addresses\n");
 	fprintf(stderr, "      --<fmt>  set default format\n");
+	fprintf(stderr, "      -J#      dump with # threads\n");
+	fprintf(stderr, "      -M<file> dump files listed in <file>\n");
+	fprintf(stderr, "      -O<dir>  dump each file to <dir>/<name>.dm\n");
+	fprintf(stderr, "      -P       describe how each format is printed\n");
+	fprintf(stderr, "      -R       read a dump and write the data in it\n");
+	fprintf(stderr, "      -t       follow: dump data as it is appended to the file\n");
+	fprintf(stderr, "      -T<mode> print records of item values: json, csv or bin\n");
 	fprintf(stderr, "      -V       print version number\n");
+	fprintf(stderr, "      -Z       dump compressed files without decompressing them\n");
+	fprintf(stderr, "      --stats  print counts and times to stderr at exit\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "    <fmt> is:\n");
 	fprintf(stderr, "      -b 8-bit     -c ASCII/dot   -x  hex        -j  left justify\n");
@@ -635,7 +283,8 @@ usage(char *s)
 	fprintf(stderr, "      -l 32-bit    -u UTF-8/dot   -o  octal      -p# printing width #\n");
 	fprintf(stderr, "      -L 64-bit    -U UTF-8/num   -r# radix #    -,# comma every # digits\n");
 	fprintf(stderr, "      -s signed    -e C-escape    -X  uppercase  -.# dot every # digits\n");
-	fprintf(stderr, "      -Q big-end%s  -m mnemonic                   -k  colored\n", bigendian ? "*" : " ");
-	fprintf(stderr, "      -q little-end%s\n", bigendian ? " " : "*");
+	fprintf(stderr, "      -Q big-end%s  -m mnemonic                   -k  colored\n", dm->bigendian ? "*" : " ");
+	fprintf(stderr, "      -q little-end%s                             -W  table for -w\n", dm->bigendian ? " " : "*");
+	fprintf(stderr, "      -S<fields> record: u32x,s16d,c8,_4 (unsigned, signed, chars, padding)\n");
 	exit(1);
 }
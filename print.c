@@ -3,6 +3,7 @@
  */
 
 #include <stdio.h>
+#include <errno.h>
 #include "dm.h"
 
 /*
@@ -15,118 +16,342 @@
 #define SP            ' '
 #define DEL           0x7F
 
-typedef union {
-	long long s;
-	unsigned long long u;
-} number;
+/*
+ * Size of a buffer which holds the printable form of a number:
+ * up to 64 binary digits, 63 commas, a sign and a nul.
+ */
+#define NUMBUF        136
+
+/*
+ * Size of a buffer which holds the printable form of any item,
+ * including color control sequences.
+ */
+#define ITEMBUF       (NUMBUF+16)
 
-static void printitem(struct format *f, number num);
-static char * prchar(struct format *f, number num, int *widthp);
-static char * prnum(struct format *f, number num, int *widthp);
-static char * prcodept(struct format *f, number num, int *widthp);
 static void prspaces(int n);
-extern int bigendian;
-extern int color;
+extern int stats;
+extern __thread struct stats tstats;
 
 static char * color_ctl = "\e[33m";
 static char * color_normal = "\e[m";
+static char * color_match = "\e[7m";
 
 	static void
-strcpy_color(char *buf, char *s)
+strcpy_color(struct format *f, char *buf, char *s)
 {
 	buf[0] = '\0';
-	if (color)
+	if (f->flags & COLOR)
 		strcat(buf, color_ctl);
 	strcat(buf, s);
-	if (color)
+	if (f->flags & COLOR)
 		strcat(buf, color_normal);
 }
 
+/*
+ * Output is collected in a buffer.
+ * The standard output buffer is written with write(2) when it fills,
+ * rather than going through stdio a few characters at a time.
+ * A buffer with no file (used by a worker thread) just grows.
+ * A buffer supplied by a caller of the library (OUTFIXED) never grows;
+ * the caller makes sure it has room for each line before printing it.
+ * Each thread prints into its own current buffer.
+ */
+static struct outbuf stdoutbuf = { NULL, 0, 0, 1, 0, NULL, 0 };
+static __thread struct outbuf *out = &stdoutbuf;
+
+/*
+ * Write n bytes to a file.
+ */
+	static void
+wrout(int fd, char *s, size_t n)
+{
+	double t = stats ? stat_now() : 0;
+
+	while (n > 0) {
+		ssize_t w = write(fd, s, n);
+		if (w < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "dm: write error\n");
+			exit(1);
+		}
+		s += w;
+		n -= w;
+	}
+	if (stats)
+		tstats.twrite += stat_now() - t;
+}
+
+/*
+ * Write everything in the output buffer.
+ */
+	void
+prflush(void)
+{
+	if (out->fd < 0)
+		return;
+	wrout(out->fd, out->buf, out->len);
+	out->len = 0;
+}
+
+/*
+ * Flush the output at the end of a line if the output is a terminal,
+ * so an interactive user sees each line as it is produced.
+ */
+	void
+prendline(void)
+{
+	if (out->tty)
+		prflush();
+}
+
+/*
+ * Print into a different buffer (or the standard output if NULL).
+ * Returns the buffer which was being printed into.
+ */
+	struct outbuf *
+prsetout(struct outbuf *ob)
+{
+	struct outbuf *old = out;
+
+	out = (ob != NULL) ? ob : &stdoutbuf;
+	return (old);
+}
+
+/*
+ * Return room for a copy of a line of n bytes.
+ * It belongs to the current output buffer, so each thread has its own;
+ * it is allocated for the first line which needs it, and then reused.
+ */
+	u8 *
+prlinebuf(size_t n)
+{
+	if (out->linesize < n) {
+		if (out->fd == OUTFIXED) {
+			/* The caller's buffer is too small: see proom. */
+			out->full = 1;
+			out->len = 0;
+			return ((u8 *) out->buf);
+		}
+		if ((out->line = (u8 *) realloc(out->line, n)) == NULL)
+			panic("cannot allocate line buffer");
+		out->linesize = n;
+	}
+	return (out->line);
+}
+
+/*
+ * Write the contents of a buffer to the standard output.
+ */
+	void
+proutbuf(struct outbuf *ob)
+{
+	prflush();
+	wrout(1, ob->buf, ob->len);
+}
+
+/*
+ * Make room for n more bytes in the output buffer.
+ */
+	static char *
+proom(size_t n)
+{
+	if (out->len + n > out->size) {
+		if (out->fd == OUTFIXED) {
+			/*
+			 * The caller's buffer is too small.
+			 * It is always big enough for one line, which is
+			 * more than is asked for at once, so print over
+			 * what is there, and let the caller see it is full.
+			 */
+			out->full = 1;
+			out->len = 0;
+			return (out->buf);
+		}
+		if (out->buf == NULL && out->fd >= 0) {
+			out->size = OUTBUFSIZE;
+			if ((out->buf = (char *) malloc(out->size)) == NULL)
+				panic("cannot allocate output buffer");
+			out->tty = isatty(out->fd);
+		} else {
+			prflush();
+		}
+		if (out->len + n > out->size) {
+			out->size = (2 * out->size > out->len + n) ?
+				2 * out->size : out->len + n;
+			if ((out->buf = (char *) realloc(out->buf, out->size)) == NULL)
+				panic("cannot allocate output buffer");
+		}
+	}
+	return (out->buf + out->len);
+}
+
+/*
+ * Print n bytes.
+ */
+	void
+prbytes(char *s, size_t n)
+{
+	memcpy(proom(n), s, n);
+	out->len += n;
+}
+
 /*
  * Print a string.
  */
 	void
 prstring(char *s)
 {
-	fputs(s, stdout);
+	prbytes(s, strlen(s));
 }
 
 /*
  * Pad with spaces on the left or right as required.
  */
 	static void
-prjust(struct format *f, char *s, int width) 
+prjust_left(struct format *f, char *s, int width) 
 {
-	if (f->flags & LEFTJUST) {
-		prstring(s);
-		prspaces(f->width - width);
-	} else {
-		prspaces(f->width - width);
-		prstring(s);
-	}
+	prstring(s);
+	prspaces(f->width - width);
+}
+
+	static void
+prjust_right(struct format *f, char *s, int width) 
+{
+	prspaces(f->width - width);
+	prstring(s);
+}
+
+/*
+ * Extract a single item from a buffer.
+ * There is one of these for each size and byte order.
+ */
+	static u64
+get_8(u8 *b)
+{
+	return (b[0]);
+}
+
+	static u64
+get_16le(u8 *b)
+{
+	return ((u64) b[1] << 8 | b[0]);
+}
+
+	static u64
+get_16be(u8 *b)
+{
+	return ((u64) b[0] << 8 | b[1]);
+}
+
+	static u64
+get_32le(u8 *b)
+{
+	return ((u64) b[3] << 24 | (u64) b[2] << 16 | (u64) b[1] << 8 | b[0]);
+}
+
+	static u64
+get_32be(u8 *b)
+{
+	return ((u64) b[0] << 24 | (u64) b[1] << 16 | (u64) b[2] << 8 | b[3]);
+}
+
+	static u64
+get_64le(u8 *b)
+{
+	return (get_32le(b+4) << 32 | get_32le(b));
+}
+
+	static u64
+get_64be(u8 *b)
+{
+	return (get_32be(b) << 32 | get_32be(b+4));
 }
 
 /*
  * Print a buffer of data according to a given format.
  * size is the nominal size of the buffer; the amount to print.
- * len is
+ * len is the amount of valid data in the buffer; may be less than size
+ *   (on the last line of the file).
  * rlen is the amount of data actually in the buffer; may exceed size.
  */
 	void
 printbuf(struct format *f, u8 *buf, ssize_t size, ssize_t len, ssize_t rlen)
 {
-	number num;
-	int i;
+	(*f->line)(f, buf, size, len, rlen);
+}
 
-	if (f->flags & NOPRINT)
-		/*
-		 * This strange flag which says "don't print anything"
-		 * is usually used only with the address format to 
-		 * suppress addresses.
-		 */
+/*
+ * Print a buffer of data like printbuf, but highlight
+ * each item which has a byte set in mark[] (if coloring).
+ * Each item is printed on its own by the format's line printer,
+ * with the inter and after strings printed here.
+ */
+	void
+prmarked(struct format *f, u8 *buf, ssize_t size, ssize_t len, ssize_t rlen, u8 *mark)
+{
+	struct format g;
+	int psize = (f->size > 0) ? f->size : 1;
+	ssize_t i;
+
+	if (!(f->flags & COLOR) || (f->flags & NOPRINT)) {
+		printbuf(f, buf, size, len, rlen);
 		return;
+	}
+	g = *f;
+	g.after = "";
+	for (i = 0;  i < size;  i += psize) {
+		int hl = 0;
+		int k;
+		for (k = i;  k < i + psize && k < size;  k++)
+			hl |= mark[k];
+		if (i > 0)
+			prstring(f->inter);
+		if (hl)
+			prstring(color_match);
+		(*g.line)(&g, buf + i, psize, len - i, rlen - i);
+		if (hl)
+			prstring(color_normal);
+	}
+	prstring(f->after);
+}
+
+/*
+ * Line printer for a format which is not displayed.
+ * This strange flag which says "don't print anything"
+ * is usually used only with the address format to 
+ * suppress addresses.
+ */
+	static void
+pr_noprint(struct format *f, u8 *buf, ssize_t size, ssize_t len, ssize_t rlen)
+{
+}
+
+/*
+ * Line printer for fixed size items.
+ */
+	static void
+pr_items(struct format *f, u8 *buf, ssize_t size, ssize_t len, ssize_t rlen)
+{
+	int isize = f->size;
+	number num;
+	int width;
+	char *s;
+	char ibuf[ITEMBUF];
 
 	while (size > 0) {
-		int isize = (f->size > 0) ? f->size : 1;
-		int spec_char = 0;
 		if (len <= 0) {
 			/* No more data in the buffer; just print spaces. */
 			prspaces(f->width);
 		} else {
 			/* Extract the next number and print it. */
-			num.u = 0;
-			if (f->flags & UTF_8) {
-				int usize = rlen;
-				int uvalue = utf8_value(buf, &usize);
-				if (uvalue == UTF_CONTIN)
-					spec_char = PR_CONTIN;
-				else if (uvalue == UTF_ERROR)
-					spec_char = PR_MALFORMED;
-				else
-					num.u = uvalue;
-					/* Don't set isize=usize, because we want to dump the contin bytes */
-			} else  {
-				if ((f->flags & DM_BIG_ENDIAN) || (!(f->flags & DM_LITTLE_ENDIAN) && bigendian)) {
-					for (i = 0;  i < isize;  i++)
-						num.u = (256 * num.u) + buf[i];
-				} else {
-					for (i = isize-1;  i >= 0;  i--)
-						num.u = (256 * num.u) + buf[i];
-				}
-			}
-			if (spec_char) {
-				char spec_str[] = { spec_char, '\0' };
-				char buf[64];
-				strcpy_color(buf, spec_str);
-				prjust(f, buf, strlen(spec_str));
-			} else {
-				printitem(f, num);
-			}
+			num.u = (*f->get)(buf);
+			s = (*f->item)(f, num, ibuf, &width);
+			(*f->just)(f, s, width);
 		}
 		buf += isize;
 		size -= isize;
 		len -= isize;
-		rlen -= isize;
 		/*
 		 * If there is another number after this one,
 		 * print the "inter" string.
@@ -138,101 +363,441 @@ printbuf(struct format *f, u8 *buf, ssize_t size, ssize_t len, ssize_t rlen)
 }
 
 /*
- * Print a single data item according to a given format.
+ * Line printer for a record of fields.
+ * Each field is extracted from its offset in the record,
+ * and printed with its own item converter, in one pass.
+ * A field which the data does not reach is printed as spaces.
  */
 	static void
-printitem(struct format *f, number num)
+pr_record(struct format *f, u8 *buf, ssize_t size, ssize_t len, ssize_t rlen)
 {
+	struct format *fl;
+	number num;
+	int width;
 	char *s;
+	char ibuf[ITEMBUF];
+
+	for (fl = f->fields;  fl < f->fields + f->nfields;  fl++) {
+		if (fl->flags & NOPRINT)
+			continue;
+		if (fl->offset + fl->size > len) {
+			prspaces(fl->width);
+		} else {
+			num.u = (*fl->get)(buf + fl->offset);
+			s = (*fl->item)(fl, num, ibuf, &width);
+			(*fl->just)(fl, s, width);
+		}
+		prstring(fl->after);
+	}
+	prstring(f->after);
+}
+
+/*
+ * Entries in a UTF-8 format's table after the ASCII characters.
+ */
+#define UCELL_CONTIN    0x80  /* A continuation byte */
+#define UCELL_MALFORMED 0x81  /* A malformed byte */
+#define UCELLS          0x82
+
+/*
+ * Line printer for UTF-8 characters.
+ * Each byte position gets one item, which is a character
+ * (if a character starts there), a continuation byte,
+ * or a malformed byte.
+ * Runs of ASCII characters are found a block at a time and copied
+ * from the table, as are continuation and malformed bytes;
+ * only a multibyte character is decoded and rendered.
+ */
+	static void
+pr_utf8(struct format *f, u8 *buf, ssize_t size, ssize_t len, ssize_t rlen)
+{
+	int interlen = strlen(f->inter);
+	ssize_t n = (len < size) ? len : size;
+	ssize_t i = 0;
+	number num;
 	int width;
+	char *s;
+	char ibuf[ITEMBUF];
 
-	/*
-	 * Get the printable form of the item.
-	 */
-	if (f->radix == 1 || (f->flags & ASCHAR))
-		s = prchar(f, num, &width);
-	else
-		s = prnum(f, num, &width);
-	prjust(f, s, width);
+	while (i < n) {
+		u8 *cell;
+		if (buf[i] < 0x80) {
+			/* Copy a run of ASCII characters. */
+			ssize_t run = ascii_span(buf + i, n - i);
+			ssize_t total = 0;
+			ssize_t k;
+			char *o;
+			for (k = 0;  k < run;  k++)
+				total += (u8) f->table[buf[i+k] * f->cellsize];
+			o = proom(total);
+			for (k = 0;  k < run;  k++) {
+				cell = (u8 *) f->table + buf[i+k] * f->cellsize;
+				memcpy(o, cell + 1, cell[0]);
+				o += cell[0];
+			}
+			out->len = o - out->buf;
+			i += run;
+			if (i == size)
+				/* The last item on the line has no inter string. */
+				out->len -= interlen;
+			continue;
+		}
+		if (utf8_is_contin(buf[i])) {
+			cell = (u8 *) f->table + UCELL_CONTIN * f->cellsize;
+		} else {
+			int usize = rlen - i;
+			int uvalue = utf8_value(buf + i, &usize);
+			if (uvalue == UTF_ERROR) {
+				cell = (u8 *) f->table + UCELL_MALFORMED * f->cellsize;
+			} else {
+				num.u = uvalue;
+				s = (*f->item)(f, num, ibuf, &width);
+				(*f->just)(f, s, width);
+				if (++i < size)
+					prbytes(f->inter, interlen);
+				continue;
+			}
+		}
+		i++;
+		prbytes((char *) cell + 1, cell[0] - (i < size ? 0 : interlen));
+	}
+	for (;  i < size;  i++) {
+		/* No more data in the buffer; just print spaces. */
+		prspaces(f->width);
+		if (i + 1 < size)
+			prbytes(f->inter, interlen);
+	}
+	prstring(f->after);
 }
 
 /*
- * Return the printable form of a number.
+ * Line printer for UTF-8 characters.
+ * Each byte position gets one item, which is a character
+ * (if a character starts there), a continuation byte,
+ * or a malformed byte.
+ * This is used only if the items are too wide for pr_utf8's table.
  */
-	static char *
-prnum(struct format *f, number num, int *widthp)
+	static void
+pr_utf8_items(struct format *f, u8 *buf, ssize_t size, ssize_t len, ssize_t rlen)
 {
-	unsigned long unum;
+	number num;
+	int width;
 	char *s;
-	int d;
-	int v;
-	int comma;
-	int neg;
-	char digits[70];
-	static char buf[70];
+	char ibuf[ITEMBUF];
 
-	/*
-	 * Get the raw unsigned number.
-	 * We negate the number if it is already negative
-	 * (and we are treating it as a signed number).
-	 */
-	if (!(f->flags & SIGNED)) {
-		neg = 0;
-		unum = num.u;
-	} else if ((neg = (num.s < 0))) {
-		unum = -(num.s);
+	while (size > 0) {
+		if (len <= 0) {
+			/* No more data in the buffer; just print spaces. */
+			prspaces(f->width);
+		} else {
+			int spec_char = 0;
+			int usize = rlen;
+			int uvalue = utf8_value(buf, &usize);
+			/* Don't advance by usize, because we want to dump the contin bytes */
+			if (uvalue == UTF_CONTIN)
+				spec_char = PR_CONTIN;
+			else if (uvalue == UTF_ERROR)
+				spec_char = PR_MALFORMED;
+			if (spec_char) {
+				char spec_str[] = { spec_char, '\0' };
+				strcpy_color(f, ibuf, spec_str);
+				(*f->just)(f, ibuf, strlen(spec_str));
+			} else {
+				num.u = uvalue;
+				s = (*f->item)(f, num, ibuf, &width);
+				(*f->just)(f, s, width);
+			}
+		}
+		buf++;
+		size--;
+		len--;
+		rlen--;
+		if (size > 0)
+			prstring(f->inter);
+	}
+	prstring(f->after);
+}
+
+/*
+ * Line printer using a table of rendered items.
+ * Each table entry is a length byte followed by the item,
+ * already padded to the width, followed by the inter string.
+ */
+	static void
+pr_table(struct format *f, u8 *buf, ssize_t size, ssize_t len, ssize_t rlen)
+{
+	int isize = f->size;
+	int interlen = strlen(f->inter);
+
+	for (;  size > 0;  buf += isize, len -= isize) {
+		size -= isize;
+		if (len <= 0) {
+			/* No more data in the buffer; just print spaces. */
+			prspaces(f->width);
+			if (size > 0)
+				prbytes(f->inter, interlen);
+		} else {
+			u8 *cell = (u8 *) f->table + (*f->get)(buf) * f->cellsize;
+			/* The last item on the line has no inter string. */
+			prbytes((char *) cell + 1, cell[0] - (size > 0 ? 0 : interlen));
+		}
+	}
+	prstring(f->after);
+}
+
+/*
+ * Line printer for zero padded hex and binary items,
+ * which converts 16 bytes of data at a time.
+ */
+	static void
+pr_vec(struct format *f, u8 *buf, ssize_t size, ssize_t len, ssize_t rlen)
+{
+	int isize = f->size;
+	int nd = f->width;
+	int per = VECBLOCK / isize;
+	int interlen = strlen(f->inter);
+	ssize_t nitems = (size + isize - 1) / isize;
+	ssize_t ndata = (len + isize - 1) / isize;
+	u8 block[VECBLOCK];
+	char digits[8*VECBLOCK];
+
+	if (ndata > nitems)
+		ndata = nitems;
+	while (ndata > 0) {
+		int k = (ndata < per) ? ndata : per;
+		u8 *in = buf;
+		char *o;
+		char *d;
+		int i;
+
+		if (rlen < VECBLOCK) {
+			/* Don't read past the end of the buffer. */
+			memset(block, 0, sizeof(block));
+			if (rlen > 0)
+				memcpy(block, buf, rlen);
+			in = block;
+		}
+		(*f->block)(in, digits, f->perm, f->num.digitch);
+		o = proom(k * (nd + interlen));
+		for (i = 0, d = digits;  i < k;  i++, d += nd) {
+			memcpy(o, d, nd);
+			o += nd;
+			/* The last item on the line has no inter string. */
+			if (--nitems > 0) {
+				memcpy(o, f->inter, interlen);
+				o += interlen;
+			}
+		}
+		out->len = o - out->buf;
+		buf += VECBLOCK;
+		rlen -= VECBLOCK;
+		ndata -= k;
+	}
+	while (nitems-- > 0) {
+		/* No more data in the buffer; just print spaces. */
+		prspaces(f->width);
+		if (nitems > 0)
+			prbytes(f->inter, interlen);
+	}
+	prstring(f->after);
+}
+
+/*
+ * Converters from a number to its digits.
+ * Each one puts the digits just before end
+ * and returns a pointer to the most significant digit.
+ * There is one for power-of-two radices (shift and mask),
+ * one for decimal (two digits at a time, dividing by a constant,
+ * which the compiler does with a multiplication),
+ * and one for any other radix (multiplying by a precomputed inverse).
+ */
+	static char *
+conv_pow2(struct numfmt *nf, u64 unum, char *end)
+{
+	int shift = nf->shift;
+	u64 mask = nf->radix - 1;
+
+	do {
+		*--end = nf->digitch[unum & mask];
+		unum >>= shift;
+	} while (unum != 0);
+	return (end);
+}
+
+static char pairs[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+	static char *
+conv_dec(struct numfmt *nf, u64 unum, char *end)
+{
+	while (unum >= 100) {
+		char *p = &pairs[2 * (unum % 100)];
+		unum /= 100;
+		*--end = p[1];
+		*--end = p[0];
+	}
+	if (unum >= 10) {
+		char *p = &pairs[2 * unum];
+		*--end = p[1];
+		*--end = p[0];
 	} else {
-		unum = num.s;
+		*--end = '0' + unum;
 	}
+	return (end);
+}
 
-	/*
-	 * Get the digits of the number, in the current radix.
-	 * We continue until we run out of nonzero digits, and
-	 * (if we are zero padding) we reach the maximum width.
-	 * Always get at least one digit, even if the number is zero.
-	 */
-	int width = (f->flags & UTF_8) ? 4 : (f->flags & ZEROPAD) ? f->zwidth : 0;
-	d = 0;
-	if ((comma = f->comma) == 0)
-		comma = 10000; /* more than the possible number of digits */
+/*
+ * Divide by the radix, using the inverse set up by setnumfmt().
+ */
+	static u64
+divradix(struct numfmt *nf, u64 n)
+{
+#ifdef __SIZEOF_INT128__
+	u64 t = (u64) (((unsigned __int128) n * nf->magic) >> 64);
+	return ((t + ((n - t) >> 1)) >> (nf->shift - 1));
+#else
+	return (n / nf->radix);
+#endif
+}
+
+	static char *
+conv_radix(struct numfmt *nf, u64 unum, char *end)
+{
 	do {
-		digits[d++] = unum % f->radix;
-		unum /= f->radix;
-		if (--comma <= 0) {
-			digits[d++] = DCOMMA;
-			comma = f->comma;
-		}
-	} while (unum != 0 || d < width);  
-	/* until (unum == 0 && d >= width) */
+		u64 q = divradix(nf, unum);
+		*--end = nf->digitch[unum - q * nf->radix];
+		unum = q;
+	} while (unum != 0);
+	return (end);
+}
 
-	if (digits[d-1] == DCOMMA)
-		d--;
+/*
+ * Set up the converter for a radix.
+ */
+	static void
+setnumfmt(struct numfmt *nf)
+{
+	int l;
+
+	for (l = 0;  (1 << l) < nf->radix;  l++)
+		continue;
+	if (nf->radix == (1 << l)) {
+		nf->conv = conv_pow2;
+		nf->shift = l;
+		nf->convname = "pow2";
+	} else if (nf->radix == 10) {
+		nf->conv = conv_dec;
+		nf->convname = "dec";
+	} else {
+		/*
+		 * Division by invariant integers using multiplication
+		 * (Granlund and Montgomery): with l = ceil(log2(radix)),
+		 * magic = 2^64 * (2^l - radix) / radix + 1.
+		 */
+		nf->conv = conv_radix;
+		nf->shift = l;
+#ifdef __SIZEOF_INT128__
+		nf->magic = (u64) ((((unsigned __int128) 1 << 64) *
+			((1 << l) - nf->radix)) / nf->radix + 1);
+#endif
+		nf->convname = "inverse";
+	}
+}
+
+/*
+ * Put the digits of a number into a buffer,
+ * zero padded to the minimum width and with commas inserted.
+ * Returns a pointer to the end of the digits.
+ */
+	static char *
+prdigits(struct numfmt *nf, u64 unum, char *s)
+{
+	char raw[NUMBUF];
+	char *end = &raw[sizeof(raw)];
+	char *p = (*nf->conv)(nf, unum, end);
+	int ndig = end - p;
+	int pad;
+
+	if (nf->comma == 0) {
+		pad = nf->minwidth - ndig;
+		if (pad > 0) {
+			memset(s, '0', pad);
+			s += pad;
+		}
+		memcpy(s, p, ndig);
+		s += ndig;
+		*s = '\0';
+		return (s);
+	}
 
 	/*
-	 * Now start producing output.
-	 * ("Output" just goes into the buffer for now.)
+	 * Insert commas, working from the least significant digit.
+	 * We continue until we run out of digits, and
+	 * (if we are zero padding) we reach the minimum width;
+	 * the width includes the commas.
 	 */
-	s = buf;
-
-	/* If signed, print the sign. */
-	if (f->flags & SIGNED)
-		*s++ = neg ? '-' : ' ';
-
-	/* Print the digits of the number. */
-	while (--d >= 0) {
-		v = digits[d];
-		if (v == DCOMMA)
-			*s++ = (f->flags & DOTCOMMA) ? '.' : ',';
-		else if (v <= 9)
-			*s++ = v + '0';
-		else if (f->flags & UPPERCASE)
-			*s++ = v + 'A' - 10;
-		else
-			*s++ = v + 'a' - 10;
+	{
+		char digits[NUMBUF];
+		int d = 0;
+		int i = 0;
+		int comma = nf->comma;
+
+		do {
+			digits[d++] = (i < ndig) ? end[-1-i] : '0';
+			i++;
+			if (--comma <= 0) {
+				digits[d++] = nf->commach;
+				comma = nf->comma;
+			}
+		} while (i < ndig || d < nf->minwidth);
+		if (digits[d-1] == nf->commach)
+			d--;
+		while (--d >= 0)
+			*s++ = digits[d];
 	}
 	*s = '\0';
-	if (widthp != NULL)
-		*widthp = s - buf;
+	return (s);
+}
+
+/*
+ * Return the printable form of an unsigned number.
+ * Each of these item converters puts the printable form in buf
+ * (which has room for ITEMBUF characters) and returns it.
+ */
+	static char *
+prnum(struct format *f, number num, char *buf, int *widthp)
+{
+	char *s = prdigits(&f->num, num.u, buf);
+
+	*widthp = s - buf;
+	return (buf);
+}
+
+/*
+ * Return the printable form of a signed number.
+ */
+	static char *
+prsnum(struct format *f, number num, char *buf, int *widthp)
+{
+	char *s = buf;
+
+	if (f->size > 0 && f->size < 8)
+		/* Extend the sign bit of the item. */
+		num.s = (s64) (num.u << (64 - 8*f->size)) >> (64 - 8*f->size);
+	/*
+	 * We negate the number if it is negative,
+	 * and print the sign before the digits.
+	 */
+	if (num.s < 0) {
+		*s++ = '-';
+		s = prdigits(&f->num, -(num.s), s);
+	} else {
+		*s++ = ' ';
+		s = prdigits(&f->num, num.s, s);
+	}
+	*widthp = s - buf;
 	return (buf);
 }
 
@@ -254,64 +819,289 @@ static char *cstyle[] =
 
 #define TABLESIZE(table) (sizeof(table)/sizeof(char *))
 
+static char lowerdigits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+static char upperdigits[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+	static int
+ascii_is_printable(unsigned long ch)
+{
+	return (ch >= 0x20 && ch < 0x7f);
+}
+
+/*
+ * Return the printable form of a printable character.
+ */
+	static char *
+prprintable(unsigned n, char *buf, int *widthp)
+{
+	int len;
+
+	utf8_encode(n, (u8*) buf, &len);
+	buf[len] = '\0';
+	*widthp = utf8_is_wide(n) ? 2 : 1;
+	return (buf);
+}
+
+/*
+ * Return a non-printable form of a character, colored if required.
+ */
+	static char *
+prnonprint(struct format *f, char *s, char *buf, int *widthp)
+{
+
+	*widthp = strlen(s);
+	if (f->flags & COLOR)
+		strcpy_color(f, buf, s);
+	else
+		strcpy(buf, s);
+	return (buf);
+}
 
 /*
  * Print a character as a number.
  */
 	static char *
-prcodept(struct format *f, number num, int *widthp)
+prcodept(struct format *f, number num, char *buf, int *widthp)
+{
+	char *s = prdigits(&f->cnum, num.u, buf);
+
+	*widthp = s - buf;
+	return (buf);
+}
+
+/*
+ * Return the printable form of a character
+ * whose non-printable form is a period.
+ */
+	static char *
+prchar_dot(struct format *f, number num, char *buf, int *widthp)
 {
-	struct format cformat = *f;
-	cformat.size = 1;
-	cformat.flags = ZEROPAD | (f->flags & (UPPERCASE|UTF_8));
-	return prnum(&cformat, num, widthp);
+	unsigned n = num.u;
+
+	if ((*f->printable)(n))
+		return (prprintable(n, buf, widthp));
+	return (prnonprint(f, ".", buf, widthp));
 }
 
 /*
- * Return the printable form of a character.
+ * Return the printable form of a character
+ * whose non-printable form is a mnemonic, escape sequence or number.
  */
 	static char *
-prchar(struct format *f, number num, int *widthp)
+prchar(struct format *f, number num, char *buf, int *widthp)
 {
 	unsigned n = num.u;
 	char *s;
-	static char buf[64];
-	int set_color = color;
-
-	/* if (f->flags & SIGNED) panic("prchar signed"); */
-	int printable = (f->flags & UTF_8) ? utf8_is_printable(n) : (n >= 0x20 && n < 0x7f);
+	char nbuf[NUMBUF];
 
-	if (f->flags & DM_CODEPT) {
-		s = prcodept(f, num, widthp);
-		set_color = 0;
-	} else if (printable) {
-		int len;
-		utf8_encode(n, (u8*) buf, &len);
-		buf[len] = '\0';
-		*widthp = utf8_is_wide(n) ? 2 : 1;
-		return (buf);
-	} else if ((f->flags & ASCHAR) == 0) {
-		/* Just print non-printables as ".". */
-		s = ".";
-	} else if ((f->flags & CSTYLE) &&
+	if ((*f->printable)(n))
+		return (prprintable(n, buf, widthp));
+	if (f->cstyle != NULL &&
 		n < TABLESIZE(cstyle) && cstyle[n] != NULL) {
 		/* C-style escape sequences for certain non-printables. */
 		s = cstyle[n];
-	} else if ((f->flags & MNEMONIC) && n < TABLESIZE(aschar)) {
+	} else if (f->mnemonic != NULL && n < TABLESIZE(aschar)) {
 		/* Special mnemonic ASCII form for certain non-printables. */
 		s = aschar[n];
-	} else if ((f->flags & MNEMONIC) && n == DEL) {
+	} else if (f->mnemonic != NULL && n == DEL) {
 		/* Special mnemonic ASCII form; special case for DEL. */
 		s = "DEL";
 	} else {
-		s = prcodept(f, num, widthp);
+		s = prcodept(f, num, nbuf, widthp);
 	}
-	*widthp = strlen(s);
-	if (set_color)
-		strcpy_color(buf, s);
-	else
-		strcpy(buf, s);
-	return buf;
+	return (prnonprint(f, s, buf, widthp));
+}
+
+/*
+ * Return every character as the number of its codepoint.
+ */
+	static char *
+prchar_codept(struct format *f, number num, char *buf, int *widthp)
+{
+	return (prcodept(f, num, buf, widthp));
+}
+
+/*
+ * Render a single item, padded and followed by the inter string,
+ * into a table entry.  Returns the length of the entry.
+ */
+	static int
+rendercell(struct format *f, u64 value, char *cell)
+{
+	number num;
+	int width;
+	int pad;
+	char *s;
+	int len;
+	char ibuf[ITEMBUF];
+
+	if ((f->flags & UTF_8) && value >= UCELL_CONTIN) {
+		char spec_str[] = { (value == UCELL_CONTIN) ? PR_CONTIN : PR_MALFORMED, '\0' };
+		strcpy_color(f, ibuf, spec_str);
+		s = ibuf;
+		width = 1;
+	} else {
+		num.u = value;
+		s = (*f->item)(f, num, ibuf, &width);
+	}
+	len = strlen(s);
+	pad = f->width - width;
+	if (pad < 0)
+		pad = 0;
+	if (cell != NULL) {
+		if (f->flags & LEFTJUST) {
+			memcpy(cell, s, len);
+			memset(cell + len, SP, pad);
+		} else {
+			memset(cell, SP, pad);
+			memcpy(cell + pad, s, len);
+		}
+		strcpy(cell + len + pad, f->inter);
+	}
+	return (len + pad + strlen(f->inter));
+}
+
+/*
+ * Build the table of rendered items for a byte or word format.
+ * A UTF-8 format's table has only the ASCII characters,
+ * plus the continuation and malformed bytes.
+ * Returns 0 if the items are too long to fit in a table.
+ */
+	static int
+settable(struct format *f)
+{
+	size_t nvalues = (f->flags & UTF_8) ? UCELLS : (f->size == 1) ? 0x100 : 0x10000;
+	int maxlen = 0;
+	size_t v;
+
+	for (v = 0;  v < nvalues;  v++) {
+		int len = rendercell(f, v, NULL);
+		if (len > maxlen)
+			maxlen = len;
+	}
+	if (maxlen > 255)
+		return (0);
+	f->cellsize = maxlen + 1;
+	if ((f->table = (char *) malloc(nvalues * f->cellsize)) == NULL)
+		/* Print each item without a table. */
+		return (0);
+	for (v = 0;  v < nvalues;  v++) {
+		char *cell = f->table + v * f->cellsize;
+		/* Render into a separate buffer, since the entry has a nul. */
+		char tmp[256+1];
+		int len = rendercell(f, v, tmp);
+		cell[0] = len;
+		memcpy(cell + 1, tmp, len);
+	}
+	return (1);
+}
+
+/*
+ * Set up the render plan for a format.
+ * All the decisions that depend only on the format's flags
+ * are made here, once, rather than for every item printed.
+ * The byte order must be set in the flags.
+ */
+	void
+setplan(struct format *f)
+{
+	int big;
+	char *lname, *gname, *iname;
+
+	/*
+	 * How to print numbers.
+	 */
+	f->num.radix = f->radix;
+	f->num.comma = f->comma;
+	f->num.commach = (f->flags & DOTCOMMA) ? '.' : ',';
+	f->num.digitch = (f->flags & UPPERCASE) ? upperdigits : lowerdigits;
+	f->num.minwidth = (f->flags & UTF_8) ? 4 : (f->flags & ZEROPAD) ? f->zwidth : 0;
+	setnumfmt(&f->num);
+	/*
+	 * How to print characters as numbers:
+	 * always zero padded, never with dots.
+	 */
+	f->cnum = f->num;
+	f->cnum.commach = ',';
+	f->cnum.minwidth = (f->flags & UTF_8) ? 4 : f->zwidth;
+
+	f->printable = (f->flags & UTF_8) ? utf8_is_printable : ascii_is_printable;
+	f->cstyle = (f->flags & CSTYLE) ? cstyle : NULL;
+	f->mnemonic = (f->flags & MNEMONIC) ? aschar : NULL;
+
+	f->just = (f->flags & LEFTJUST) ? prjust_left : prjust_right;
+
+	big = (f->flags & DM_BIG_ENDIAN) != 0;
+	switch (f->size)
+	{
+	case 8: f->get = big ? get_64be : get_64le; gname = big ? "get64be" : "get64le"; break;
+	case 4: f->get = big ? get_32be : get_32le; gname = big ? "get32be" : "get32le"; break;
+	case 2: f->get = big ? get_16be : get_16le; gname = big ? "get16be" : "get16le"; break;
+	default: f->get = get_8; gname = (f->flags & UTF_8) ? "decode" : "get8"; break;
+	}
+
+	if (f->flags & DM_CODEPT) {
+		f->item = prchar_codept; iname = "codept";
+	} else if (f->radix == 1 || (f->flags & ASCHAR)) {
+		if (f->flags & ASCHAR) {
+			f->item = prchar; iname = "char";
+		} else {
+			f->item = prchar_dot; iname = "chardot";
+		}
+	} else if (f->flags & SIGNED) {
+		f->item = prsnum; iname = "signed";
+	} else {
+		f->item = prnum; iname = "unsigned";
+	}
+
+	if (f->flags & NOPRINT) {
+		f->line = pr_noprint; lname = "noprint";
+	} else if (f->flags & RECORD) {
+		/*
+		 * Each field has its own plan, for its size and radix.
+		 */
+		int i;
+		for (i = 0;  i < f->nfields;  i++) {
+			f->fields[i].flags |= f->flags & COLOR;
+			setplan(&f->fields[i]);
+		}
+		f->line = pr_record; lname = "record";
+		gname = "fields";
+	} else if (f->flags & UTF_8) {
+		if (settable(f)) {
+			f->line = pr_utf8; lname = "utf8";
+		} else {
+			f->line = pr_utf8_items; lname = "utf8-items";
+		}
+	} else if ((f->radix == 16 || f->radix == 2) &&
+			(f->flags & (ZEROPAD|SIGNED|ASCHAR)) == ZEROPAD &&
+			f->comma == 0 && f->size > 0 &&
+			f->width == ndigits(f->radix, f->size) && f->zwidth == f->width) {
+		/*
+		 * Zero padded hex or binary: each nibble or bit
+		 * is one digit, so whole blocks can be converted at once.
+		 * The permutation puts each item's bytes in printing order.
+		 */
+		int i;
+		for (i = 0;  i < VECBLOCK;  i++)
+			f->perm[i] = big ? i : 
+				(i - i % f->size) + (f->size - 1 - i % f->size);
+		f->block = vec_block(f->radix, &lname);
+		f->line = pr_vec;
+	} else if ((f->size == 1 || (f->size == 2 && (f->flags & WTABLE))) &&
+			settable(f)) {
+		/*
+		 * Only 256 (or 65536) different items are possible,
+		 * so render them all now and just copy them later.
+		 */
+		f->line = pr_table; lname = "table";
+	} else {
+		f->line = pr_items; lname = "items";
+	}
+
+	snprintf(f->plan, sizeof(f->plan), "%s %s %s/%d %s %s",
+		lname, gname, iname, f->radix, f->num.convname,
+		(f->flags & LEFTJUST) ? "left" : "right");
 }
 
 /*
@@ -320,8 +1110,14 @@ prchar(struct format *f, number num, int *widthp)
 	static void
 prspaces(int n)
 {
-	while (--n >= 0)
-		prstring(" ");
+	if (n <= 0)
+		return;
+	while (n > OUTBUFSIZE) {
+		prspaces(OUTBUFSIZE);
+		n -= OUTBUFSIZE;
+	}
+	memset(proom(n), SP, n);
+	out->len += n;
 }
 
 /*
@@ -338,6 +1134,18 @@ defwidth(int radix, int size, int comma)
 	return (width);
 }
 
+/*
+ * Return the most bytes that printing one item of a format can take:
+ * the widest item (with any color sequences), its padding,
+ * the inter string and any highlighting.
+ */
+	size_t
+itemmax(struct format *f)
+{
+	return (ITEMBUF + f->width + strlen(f->inter) +
+		strlen(color_match) + strlen(color_normal));
+}
+
 /*
  * Return the max (unsigned) value for a given size (byte, word, long).
  */
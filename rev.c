@@ -0,0 +1,324 @@
+/*
+ * Reverse mode: read a dump made by dm, and write out the data
+ * that was dumped.
+ *
+ * The dump must have been made with the same options (formats,
+ * line size, -E and so on), so that we know the layout of each line.
+ * The data is read back from one numeric format; the other formats
+ * are ignored.  A "*" line is expanded by repeating the line before
+ * it up to the next address, and the addresses are checked to find
+ * lines which are missing or out of order.
+ */
+
+#include "dm.h"
+
+extern struct dmctx *dm;
+
+static struct format *rf; /* Format the data is read from */
+static int rrow;          /* Which line of each record holds rf */
+static int rcol;          /* Column of rf's first item, after the address */
+static int rend;          /* Or, if not 0, column counting back from the end */
+static int nrows;         /* Lines in each record */
+static int nitems;        /* Items of rf in each line */
+static int rbig;          /* Items of rf are big-endian */
+static int noaddr;        /* Addresses are not printed */
+static int indent;        /* Width of the address column */
+static signed char digval[256]; /* Value of each digit character, or -1 */
+
+/*
+ * Width of the items printed by a format for one line of data.
+ */
+	static int
+itemswidth(struct format *f)
+{
+	int psize = (f->size > 0) ? f->size : 1;
+	int n = (dm->count + psize - 1) / psize;
+
+	return (n * f->width + (n-1) * strlen(f->inter));
+}
+
+/*
+ * Can a format be read back into data?
+ */
+	static int
+readable(struct format *f)
+{
+	if (f->radix < 2 || (f->flags & (ASCHAR|UTF_8|DM_CODEPT|NOPRINT|RECORD)))
+		return (0);
+	return (f->size == 1 || f->size == 2 || f->size == 4 || f->size == 8);
+}
+
+/*
+ * Does a format always print the same number of characters?
+ * UTF-8 characters and color escapes take more bytes
+ * than the columns they fill.
+ */
+	static int
+fixedwidth(struct format *f)
+{
+	if (f->flags & UTF_8)
+		return (0);
+	return (readable(f) || !(f->flags & COLOR));
+}
+
+/*
+ * Choose the format to read the data from,
+ * and work out where its items are.
+ * They can be found by counting from the start of the line
+ * if everything before them on the line has a fixed width,
+ * or else from the end of the line, if everything after them does.
+ */
+	static int
+setrev(void)
+{
+	int fx, gx;
+	int row = -1;
+	int first = 0;   /* First format on the current line */
+	int best = -1;
+	int i;
+
+	rf = NULL;
+	for (fx = 0;  fx < dm->nformat;  fx++) {
+		struct format *f = &dm->format[fx];
+		int before = 1;
+		int after = 1;
+		int col = 0;
+		int tail = 0;
+		if (f->col == 0) {
+			row++;
+			first = fx;
+		}
+		if (!readable(f))
+			continue;
+		for (gx = first;  gx < fx;  gx++) {
+			before &= fixedwidth(&dm->format[gx]);
+			col += itemswidth(&dm->format[gx]) + strlen(dm->format[gx].after);
+		}
+		for (gx = fx;  gx < dm->nformat && (gx == fx || dm->format[gx].col > 0);  gx++) {
+			after &= fixedwidth(&dm->format[gx]);
+			if (gx > fx)
+				tail += strlen(dm->format[gx-1].after);
+			tail += itemswidth(&dm->format[gx]);
+		}
+		if ((before ? 2 : after ? 1 : 0) > best) {
+			best = before ? 2 : after ? 1 : 0;
+			rf = f;
+			rrow = row;
+			rcol = col;
+			rend = (best == 1) ? tail : 0;
+		}
+	}
+	if (rf == NULL)
+		return (-1);
+	nrows = row + 1;
+	nitems = (dm->count + rf->size - 1) / rf->size;
+	rbig = (rf->flags & DM_BIG_ENDIAN) != 0;
+	noaddr = (dm->aformat.flags & NOPRINT) != 0;
+	indent = dm->aformat.width + strlen(dm->aformat.after);
+	for (i = 0;  i < 256;  i++)
+		digval[i] = -1;
+	for (i = 0;  i < 36;  i++) {
+		digval[(u8) "0123456789abcdefghijklmnopqrstuvwxyz"[i]] = i;
+		digval[(u8) "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ"[i]] = i;
+	}
+	return (0);
+}
+
+/*
+ * Parse a number printed in format f, from s to end.
+ * Returns 1 if it is all blank, 0 if it is a number, or -1 if not.
+ */
+	static int
+getitem(struct format *f, char *s, char *end, u64 *vp)
+{
+	char commach = (f->flags & DOTCOMMA) ? '.' : ',';
+	int neg = 0;
+	u64 v = 0;
+	int nd = 0;
+
+	while (s < end && *s == ' ')
+		s++;
+	while (end > s && end[-1] == ' ')
+		end--;
+	if (s == end)
+		return (1);
+	if (*s == '-') {
+		neg = 1;
+		s++;
+	}
+	for (;  s < end;  s++) {
+		int d = digval[(u8) *s];
+		if (d < 0 || d >= f->radix) {
+			if (*s == commach && nd > 0)
+				continue;
+			return (-1);
+		}
+		v = v * f->radix + d;
+		nd++;
+	}
+	if (nd == 0)
+		return (-1);
+	*vp = neg ? -v : v;
+	return (0);
+}
+
+/*
+ * Store an item of size bytes in buf.
+ */
+	static void
+putitem(u8 *buf, int size, u64 v)
+{
+	int i;
+
+	for (i = 0;  i < size;  i++, v >>= 8)
+		buf[rbig ? size-1-i : i] = (u8) v;
+}
+
+/*
+ * Parse the address at the start of a line.
+ * Returns a pointer to the text after it, or NULL if there is none.
+ */
+	static char *
+getaddr(char *s, off_t *ap)
+{
+	char *p;
+	u64 v;
+
+	while (*s == ' ')
+		s++;
+	for (p = s;  *p != '\0' && *p != ' ' && *p != ':';  p++)
+		;
+	if (p == s || getitem(&dm->aformat, s, p, &v) != 0)
+		return (NULL);
+	while (*p == ' ')
+		p++;
+	if (*p++ != ':')
+		return (NULL);
+	if (*p == ' ')
+		p++;
+	*ap = (off_t) v;
+	return (p);
+}
+
+/*
+ * Read a dump from a file and write the data to the output.
+ * Returns -1 if the dump is not what we expect.
+ */
+	int
+undumpfile(char *filename)
+{
+	FILE *f;
+	char *line = NULL;
+	size_t linesize = 0;
+	ssize_t linelen;
+	int lineno = 0;
+	int row = 0;
+	int star = 0;          /* Saw a "*" after the last record */
+	int haveprev = 0;      /* rec holds the previous record */
+	off_t addr = 0;        /* Address of this record */
+	off_t next = -1;       /* Expected address of the next record */
+	size_t reclen = 0;
+	u8 *rec;
+	int ret = 0;
+
+	if (strcmp(filename, "-") == 0)
+		f = stdin;
+	else if ((f = fopen(filename, "r")) == NULL) {
+		fprintf(stderr, "dm: cannot open %s\n", filename);
+		return (-1);
+	}
+	if (rf == NULL && setrev() < 0) {
+		fprintf(stderr, "dm: -R needs a numeric format to read the data from\n");
+		if (f != stdin)
+			fclose(f);
+		return (-1);
+	}
+	if ((rec = (u8 *) malloc(nitems * rf->size)) == NULL)
+		panic("cannot allocate record");
+
+#define BAD(msg) { \
+	fprintf(stderr, "dm: %s line %d: %s\n", filename, lineno, msg); \
+	ret = -1; goto done; }
+
+	while ((linelen = getline(&line, &linesize, f)) >= 0) {
+		char *s = line;
+		lineno++;
+		if (linelen > 0 && line[linelen-1] == '\n')
+			line[--linelen] = '\0';
+		if (row == 0) {
+			char *p;
+			for (p = line;  *p == ' ';  p++)
+				;
+			if (*p == '\0' && (dm->group_line || noaddr))
+				/* Blank line after a record (-E). */
+				continue;
+			if (p[0] == '*' && p[1] == '\0') {
+				if (!haveprev || reclen != (size_t) dm->count)
+					BAD("\"*\" does not follow a full line");
+				star = 1;
+				continue;
+			}
+			if (!noaddr) {
+				if ((s = getaddr(line, &addr)) == NULL)
+					BAD("no address");
+				if (next >= 0 && star) {
+					/* Repeat the previous line up to this address. */
+					if (addr < next || (addr - next) % dm->count != 0)
+						BAD("address does not follow \"*\"");
+					for (;  next < addr;  next += dm->count)
+						prbytes((char *) rec, dm->count);
+				} else if (next >= 0 && addr != next)
+					BAD("address out of sequence");
+				if (*s == '\0') {
+					/* The final address; another dump may follow. */
+					next = -1;
+					haveprev = star = 0;
+					continue;
+				}
+			} else if (star) {
+				BAD("cannot expand \"*\" without addresses");
+			}
+			star = 0;
+		}
+		if (row == rrow) {
+			/* The items of the format we read from. */
+			char *end = line + linelen;
+			int i;
+			if (rend != 0)
+				s = (end - s >= rend) ? end - rend : end;
+			else if (row > 0)
+				s = (linelen > indent + rcol) ? line + indent + rcol : end;
+			else
+				s = (end - s > rcol) ? s + rcol : end;
+			reclen = 0;
+			for (i = 0;  i < nitems && s < end;  i++) {
+				char *e = (s + rf->width < end) ? s + rf->width : end;
+				u64 v;
+				int r = getitem(rf, s, e, &v);
+				if (r < 0)
+					BAD("bad item");
+				if (r > 0)
+					/* No more data (the last line). */
+					break;
+				putitem(rec + reclen, rf->size, v);
+				reclen += rf->size;
+				s = e + strlen(rf->inter);
+			}
+			if (reclen > (size_t) dm->count)
+				reclen = dm->count;
+		}
+		if (++row == nrows) {
+			prbytes((char *) rec, reclen);
+			haveprev = 1;
+			next = addr + dm->count;
+			row = 0;
+		}
+	}
+#undef BAD
+done:
+	free(line);
+	free(rec);
+	if (f != stdin)
+		fclose(f);
+	return (ret);
+}
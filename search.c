@@ -0,0 +1,139 @@
+/*
+ * Search mode: dump only the lines around each occurrence of a pattern.
+ *
+ * The input is searched a large block at a time.
+ * When a match is found, the lines before it (the context) are
+ * still in the input buffer, in the history kept before in->data,
+ * so they can be printed without going back in the file.
+ * Lines are then printed one at a time, up to the context after
+ * the last match seen, looking for more matches in each line
+ * as it is printed.  Lines stay on the usual grid: every line
+ * starts a multiple of count bytes from the start of the range.
+ */
+
+#include "dm.h"
+
+extern struct dmctx *dm;
+extern u8 *pattern;
+extern size_t patlen;
+extern int context;
+
+/*
+ * Amount of input to search at once,
+ * unless a line plus the pattern is bigger.
+ */
+#define SEARCHBLOCK  (INBUFSIZE/2)
+
+/*
+ * Number of bytes before in->data which the input must keep.
+ */
+	size_t
+searchhist(void)
+{
+	return ((context + 1) * dm->count + patlen);
+}
+
+/*
+ * Dump the lines around each match in one range of a file,
+ * from in->addr to in->end.
+ * Groups of lines which are not next to each other are separated
+ * by a "--" line.
+ */
+	void
+searchrange(struct input *in)
+{
+	off_t start = in->addr;
+	off_t a = start;       /* Next line to print, or to search from */
+	off_t shown = start;   /* Lines before this are printed or passed over */
+	off_t until = start;   /* Print the lines before this */
+	int any = 0;           /* Printed a line */
+	u8 *mark;              /* Which bytes of the line are in a match */
+	int marked;            /* Some byte of the line is marked */
+	int count = dm->count;
+	size_t block = SEARCHBLOCK;
+
+	if (block < count + patlen)
+		block = count + patlen;
+	if ((mark = (u8 *) malloc(count)) == NULL)
+		panic("cannot allocate marks");
+
+	for (;;) {
+		size_t avail;
+		u8 *data;
+		off_t s;
+
+		if (a >= until) {
+			/*
+			 * Not in the context of a match:
+			 * look ahead for the next one.
+			 */
+			u8 *m;
+			off_t line;
+			in_advance(in, (size_t) (a - in->addr));
+			avail = in_fill(in, block);
+			if (avail < patlen)
+				break;
+			if ((m = findpat(in->data, avail, pattern, patlen)) == NULL) {
+				/* Pass over the lines in which no match can start. */
+				size_t skip = avail - patlen + 1;
+				skip -= skip % count;
+				if (skip == 0)
+					/* Only at the end of the input. */
+					break;
+				in_advance(in, skip);
+				a += skip;
+				continue;
+			}
+			line = a + ((m - in->data) / count) * count;
+			a = line - (off_t) context * count;
+			if (a < shown)
+				a = shown;
+			if (any && a > shown && dm->mode == OUT_TEXT) {
+				prstring("--\n");
+				prendline();
+			}
+			until = line + count;
+		}
+
+		/*
+		 * Print the line at a, which may be a line of context
+		 * before the data we have reached.
+		 */
+		if (a < in->addr) {
+			avail = in_fill(in, count + patlen + LOOKAHEAD);
+			data = in->data - (in->addr - a);
+			avail += in->addr - a;
+		} else {
+			in_advance(in, (size_t) (a - in->addr));
+			avail = in_fill(in, count + patlen + LOOKAHEAD);
+			data = in->data;
+		}
+		if (avail == 0)
+			break;
+		/*
+		 * Mark every match which overlaps the line,
+		 * and extend the context past each one which starts in it.
+		 */
+		memset(mark, 0, count);
+		marked = 0;
+		for (s = (a - start < (off_t) patlen) ? start - a : 1 - (off_t) patlen;
+				s < count && s + (off_t) patlen <= (off_t) avail;  s++) {
+			off_t k;
+			if (!eqbuf(data + s, pattern, patlen))
+				continue;
+			for (k = (s < 0) ? 0 : s;  k < s + (off_t) patlen && k < count;  k++)
+				mark[k] = marked = 1;
+			if (s >= 0) {
+				off_t e = a + s + patlen - 1;
+				e = start + ((e - start) / count + 1 + context) * count;
+				if (e > until)
+					until = e;
+			}
+		}
+		markline(dm, a, data, avail, marked ? mark : NULL);
+		any = 1;
+		a += count;
+		shown = a;
+	}
+	free(mark);
+}
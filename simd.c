@@ -0,0 +1,196 @@
+/*
+ * Convert blocks of 16 bytes to hex or binary digits.
+ *
+ * These are used for zero padded hex and binary formats,
+ * where each nibble (or bit) of the data maps directly to one
+ * output character.  Each block is first permuted into printing
+ * order (so that the most significant byte of each item comes first),
+ * then converted.
+ * On x86 processors which support SSSE3, the conversion is done
+ * with vector shuffles; otherwise a scalar version is used.
+ *
+ * Also here are the scan for runs of ASCII characters in UTF-8 data,
+ * and the search for a pattern.
+ */
+
+#include "dm.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VEC_X86 1
+#include <immintrin.h>
+#endif
+
+/*
+ * Convert 16 bytes to 32 hex digits.
+ */
+	static void
+hex_block_scalar(u8 *in, char *out, u8 *perm, char *digitch)
+{
+	int i;
+
+	for (i = 0;  i < 16;  i++) {
+		u8 b = in[perm[i]];
+		*out++ = digitch[b >> 4];
+		*out++ = digitch[b & 0xF];
+	}
+}
+
+/*
+ * Convert 16 bytes to 128 binary digits.
+ */
+	static void
+bin_block_scalar(u8 *in, char *out, u8 *perm, char *digitch)
+{
+	int i;
+	int bit;
+
+	for (i = 0;  i < 16;  i++) {
+		u8 b = in[perm[i]];
+		for (bit = 7;  bit >= 0;  bit--)
+			*out++ = '0' + ((b >> bit) & 1);
+	}
+}
+
+#ifdef VEC_X86
+
+	__attribute__((target("ssse3"))) static void
+hex_block_ssse3(u8 *in, char *out, u8 *perm, char *digitch)
+{
+	__m128i x = _mm_loadu_si128((__m128i *) in);
+	__m128i lut = _mm_loadu_si128((__m128i *) digitch);
+	__m128i mask = _mm_set1_epi8(0x0F);
+
+	x = _mm_shuffle_epi8(x, _mm_loadu_si128((__m128i *) perm));
+	__m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(x, 4), mask));
+	__m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(x, mask));
+	_mm_storeu_si128((__m128i *) out, _mm_unpacklo_epi8(hi, lo));
+	_mm_storeu_si128((__m128i *) (out+16), _mm_unpackhi_epi8(hi, lo));
+}
+
+	__attribute__((target("ssse3"))) static void
+bin_block_ssse3(u8 *in, char *out, u8 *perm, char *digitch)
+{
+	__m128i x = _mm_loadu_si128((__m128i *) in);
+	__m128i bits = _mm_set_epi8(
+		0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char) 0x80,
+		0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char) 0x80);
+	__m128i zero = _mm_set1_epi8('0');
+	int i;
+
+	x = _mm_shuffle_epi8(x, _mm_loadu_si128((__m128i *) perm));
+	for (i = 0;  i < 16;  i += 2) {
+		/*
+		 * Spread two bytes over 8 lanes each,
+		 * and pick out one bit in each lane.
+		 */
+		__m128i sel = _mm_shuffle_epi8(x, _mm_set_epi8(
+			i+1, i+1, i+1, i+1, i+1, i+1, i+1, i+1,
+			i, i, i, i, i, i, i, i));
+		__m128i set = _mm_cmpeq_epi8(_mm_and_si128(sel, bits), bits);
+		/* set is -1 where the bit is set, so subtracting it gives '1'. */
+		_mm_storeu_si128((__m128i *) (out + 8*i), _mm_sub_epi8(zero, set));
+	}
+}
+
+	static int
+have_ssse3(void)
+{
+	static int have = -1;
+
+	if (have < 0) {
+		__builtin_cpu_init();
+		have = __builtin_cpu_supports("ssse3");
+	}
+	return (have);
+}
+
+#endif
+
+/*
+ * Choose the block converter for a radix (16 or 2).
+ * Sets *namep to a description of the converter.
+ */
+	blockfn
+vec_block(int radix, char **namep)
+{
+#ifdef VEC_X86
+	if (have_ssse3()) {
+		*namep = (radix == 16) ? "hex-ssse3" : "bin-ssse3";
+		return ((radix == 16) ? hex_block_ssse3 : bin_block_ssse3);
+	}
+#endif
+	*namep = (radix == 16) ? "hex-scalar" : "bin-scalar";
+	return ((radix == 16) ? hex_block_scalar : bin_block_scalar);
+}
+
+/*
+ * Return the number of bytes at the start of buf (up to n)
+ * which are ASCII characters.
+ */
+	size_t
+ascii_span(u8 *buf, size_t n)
+{
+	size_t i = 0;
+
+#if defined(VEC_X86) && defined(__SSE2__)
+	/* Test 16 bytes at a time: the high bit of each byte goes in the mask. */
+	for (;  i + 16 <= n;  i += 16) {
+		int mask = _mm_movemask_epi8(_mm_loadu_si128((__m128i *) (buf + i)));
+		if (mask != 0)
+			return (i + __builtin_ctz(mask));
+	}
+#else
+	for (;  i + 8 <= n;  i += 8) {
+		u64 w;
+		memcpy(&w, buf + i, sizeof(w));
+		if (w & 0x8080808080808080ULL)
+			break;
+	}
+#endif
+	while (i < n && buf[i] < 0x80)
+		i++;
+	return (i);
+}
+
+/*
+ * Find the first occurrence of pat (plen bytes) in buf (n bytes).
+ * Returns a pointer to it, or NULL if there is none.
+ * Candidates are found by testing 16 positions at once for both the
+ * first and the last byte of the pattern; only where both match is
+ * the rest of the pattern compared.
+ */
+	u8 *
+findpat(u8 *buf, size_t n, u8 *pat, size_t plen)
+{
+	size_t i = 0;
+
+	if (plen == 0 || plen > n)
+		return (NULL);
+#if defined(VEC_X86) && defined(__SSE2__)
+	{
+		__m128i first = _mm_set1_epi8((char) pat[0]);
+		__m128i last = _mm_set1_epi8((char) pat[plen-1]);
+		for (;  i + plen - 1 + 16 <= n;  i += 16) {
+			__m128i f = _mm_loadu_si128((__m128i *) (buf + i));
+			__m128i l = _mm_loadu_si128((__m128i *) (buf + i + plen - 1));
+			int mask = _mm_movemask_epi8(_mm_and_si128(
+				_mm_cmpeq_epi8(f, first), _mm_cmpeq_epi8(l, last)));
+			while (mask != 0) {
+				size_t k = i + __builtin_ctz(mask);
+				if (plen <= 2 || eqbuf(buf + k + 1, pat + 1, plen - 2))
+					return (buf + k);
+				mask &= mask - 1;
+			}
+		}
+	}
+#endif
+	while (i + plen <= n) {
+		u8 *p = (u8 *) memchr(buf + i, pat[0], n - plen + 1 - i);
+		if (p == NULL)
+			return (NULL);
+		if (eqbuf(p, pat, plen))
+			return (p);
+		i = p - buf + 1;
+	}
+	return (NULL);
+}
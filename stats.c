@@ -0,0 +1,173 @@
+/*
+ * Statistics (--stats): counts of what was done, and where the time went.
+ *
+ * Each thread counts into its own struct stats, so the counting needs
+ * no locks; a worker thread adds its counts to the total when it ends,
+ * and the main thread does so when the summary is printed at exit.
+ * Time is measured only when --stats is given, around reading the
+ * input, printing each format and writing the output.
+ */
+
+#include <pthread.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "dm.h"
+
+extern int stats;
+extern __thread struct stats tstats;
+
+static struct stats total;
+static struct dmctx *ctx;      /* The formats being timed */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static double starttime;
+
+/*
+ * Progress is reported this often (in seconds),
+ * checked every PROGRESSLINES lines.
+ */
+#define PROGRESSSECS   1.0
+#define PROGRESSLINES  4096
+
+/*
+ * Add this thread's counts to the total, and clear them.
+ */
+	void
+stat_merge(void)
+{
+	int fx;
+
+	pthread_mutex_lock(&lock);
+	total.bytesread += tstats.bytesread;
+	total.bytesmapped += tstats.bytesmapped;
+	total.bytesdumped += tstats.bytesdumped;
+	total.lines += tstats.lines;
+	total.starred += tstats.starred;
+	total.discarded += tstats.discarded;
+	total.holebytes += tstats.holebytes;
+	total.tread += tstats.tread;
+	total.twrite += tstats.twrite;
+	total.taddr += tstats.taddr;
+	if (total.nformat < tstats.nformat) {
+		total.tformat = (double *) realloc(total.tformat, tstats.nformat * sizeof(double));
+		if (total.tformat == NULL)
+			panic("cannot allocate stats");
+		while (total.nformat < tstats.nformat)
+			total.tformat[total.nformat++] = 0;
+	}
+	for (fx = 0;  fx < tstats.nformat;  fx++)
+		total.tformat[fx] += tstats.tformat[fx];
+	pthread_mutex_unlock(&lock);
+	free(tstats.tformat);
+	memset(&tstats, 0, sizeof(tstats));
+}
+
+/*
+ * Print the summary to stderr.
+ */
+	static void
+prstats(void)
+{
+	struct rusage ru;
+	double wall = stat_now() - starttime;
+	double cpu = 0;
+	double accounted;
+	int fx;
+
+	stat_merge();
+	if (getrusage(RUSAGE_SELF, &ru) == 0)
+		cpu = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+			ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+	fprintf(stderr, "dm: stats\n");
+	fprintf(stderr, "  bytes read              %14lld\n", (long long) total.bytesread);
+	fprintf(stderr, "  bytes mapped            %14lld\n", (long long) total.bytesmapped);
+	fprintf(stderr, "  bytes dumped            %14lld\n", (long long) total.bytesdumped);
+	fprintf(stderr, "  lines printed           %14lld\n", (long long) total.lines);
+	fprintf(stderr, "  lines collapsed to *    %14lld\n", (long long) total.starred);
+	fprintf(stderr, "  bytes skipped in holes  %14lld\n", (long long) total.holebytes);
+	fprintf(stderr, "  bytes skipped unread    %14lld\n", (long long) total.discarded);
+	fprintf(stderr, "  time (seconds)  %9.3f wall  %9.3f cpu\n", wall, cpu);
+	fprintf(stderr, "    read          %9.3f\n", total.tread);
+	fprintf(stderr, "    address       %9.3f\n", total.taddr);
+	accounted = total.tread + total.taddr + total.twrite;
+	for (fx = 0;  fx < ctx->nformat;  fx++) {
+		double t = (fx < total.nformat) ? total.tformat[fx] : 0;
+		fprintf(stderr, "    format %-2d     %9.3f   %s\n", fx+1,
+			t, ctx->format[fx].plan);
+		accounted += t;
+	}
+	fprintf(stderr, "    write         %9.3f\n", total.twrite);
+	/* Threads overlap, so this is only meaningful with one. */
+	if (wall > accounted)
+		fprintf(stderr, "    other         %9.3f\n", wall - accounted);
+	if (total.bytesdumped > 0 && wall > 0)
+		fprintf(stderr, "  %.1f MB/s, %.0f lines/s\n",
+			total.bytesdumped / wall / (1024*1024), total.lines / wall);
+}
+
+/*
+ * Start collecting statistics for the formats in c;
+ * the summary is printed at exit.
+ */
+	void
+stat_start(struct dmctx *c)
+{
+	ctx = c;
+	stats = 1;
+	starttime = stat_now();
+	atexit(prstats);
+}
+
+/*
+ * Report progress through an input on a terminal,
+ * if it has been a while since the last report.
+ * addr is how far we have got.  If done is set, clear the report.
+ */
+	void
+stat_progress(struct input *in, off_t addr, int done)
+{
+	static __thread double last = 0;
+	static __thread double first = 0;
+	static __thread off_t firstaddr = 0;
+	static __thread int shown = 0;
+	static __thread long lines = 0;
+	static int tty = -1;
+	double t;
+	off_t size;
+
+	if (tty < 0)
+		/* Don't write over a dump on the same terminal. */
+		tty = isatty(2) && !isatty(1);
+	if (!tty)
+		return;
+	if (done) {
+		if (shown)
+			fprintf(stderr, "\r\033[K");
+		shown = 0;
+		first = 0;
+		return;
+	}
+	if (++lines % PROGRESSLINES != 0)
+		return;
+	t = stat_now();
+	if (first == 0) {
+		first = last = t;
+		firstaddr = addr;
+		return;
+	}
+	if (t - last < PROGRESSSECS)
+		return;
+	last = t;
+	size = (in->end >= 0) ? in->end : in_size(in);
+	fprintf(stderr, "\rdm: %s: %lld MB", in->name, (long long) (addr >> 20));
+	if (size > 0)
+		fprintf(stderr, " of %lld MB", (long long) (size >> 20));
+	if (t > first) {
+		double rate = (addr - firstaddr) / (t - first);
+		fprintf(stderr, ", %.1f MB/s", rate / (1024*1024));
+		if (size > addr && rate > 0)
+			fprintf(stderr, ", %.0fs left", (size - addr) / rate);
+	}
+	fprintf(stderr, "\033[K");
+	shown = 1;
+}
@@ -0,0 +1,311 @@
+/*
+ * Dump using several threads.
+ *
+ * A file which is entirely in memory is divided into chunks of whole lines.
+ * Worker threads take chunks in order and print each one into
+ * a separate buffer; the main thread writes the buffers in order.
+ * Since all the data is in memory, each chunk can look at the
+ * lines before it (to decide whether its first lines are duplicates)
+ * and at the data after it (for items and UTF-8 sequences which
+ * extend past the end of a line), so the output is the same as
+ * if the file were dumped by a single thread.
+ *
+ * A batch of files is dumped the same way, one file per job.
+ * Unless each is written to its own file (-O), a job's whole dump
+ * is held in memory until it is written, so a batch can use as much
+ * memory as the dumps of 2 * nthreads of its files.
+ */
+
+#include <pthread.h>
+#include <fcntl.h>
+#include "dm.h"
+
+extern struct dmctx *dm;
+extern int stats;
+
+/*
+ * Approximate number of bytes of data in each chunk.
+ */
+#define CHUNKSIZE (256*1024)
+
+/*
+ * Jobs are numbered from 0.
+ * Each job is run by a worker thread, printing into a separate buffer,
+ * and the main thread writes the buffers in the order of the jobs.
+ */
+struct slot
+{
+	struct outbuf ob; /* Output of the job */
+	int done;         /* ob holds the complete output */
+};
+
+static void (*jobfn)(long);
+static long njobs;       /* Total number of jobs */
+static long nextjob;     /* Next job for a worker to run */
+static long written;     /* Next job for the main thread to write */
+static struct slot *slots;
+static int nslots;       /* Max jobs run but not yet written */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+	static void *
+worker(void *arg)
+{
+	for (;;) {
+		long j;
+		struct slot *sl;
+
+		pthread_mutex_lock(&lock);
+		while (nextjob < njobs && nextjob >= written + nslots)
+			pthread_cond_wait(&cond, &lock);
+		if (nextjob >= njobs) {
+			pthread_mutex_unlock(&lock);
+			if (stats)
+				stat_merge();
+			return (NULL);
+		}
+		j = nextjob++;
+		pthread_mutex_unlock(&lock);
+
+		sl = &slots[j % nslots];
+		sl->ob.len = 0;
+		prsetout(&sl->ob);
+		(*jobfn)(j);
+
+		pthread_mutex_lock(&lock);
+		sl->done = 1;
+		pthread_cond_broadcast(&cond);
+		pthread_mutex_unlock(&lock);
+	}
+}
+
+/*
+ * Run n jobs with nthreads worker threads,
+ * writing their output in order.
+ */
+	static void
+runjobs(long n, void (*fn)(long), int nthreads)
+{
+	pthread_t *threads;
+	long j;
+	int i;
+
+	jobfn = fn;
+	njobs = n;
+	nextjob = written = 0;
+	nslots = 2 * nthreads;
+	slots = (struct slot *) calloc(nslots, sizeof(struct slot));
+	threads = (pthread_t *) malloc(nthreads * sizeof(pthread_t));
+	if (slots == NULL || threads == NULL)
+		panic("cannot allocate threads");
+	for (i = 0;  i < nslots;  i++)
+		slots[i].ob.fd = -1;
+
+	for (i = 0;  i < nthreads;  i++)
+		if (pthread_create(&threads[i], NULL, worker, NULL) != 0)
+			panic("cannot create thread");
+
+	for (j = 0;  j < njobs;  j++) {
+		struct slot *sl = &slots[j % nslots];
+
+		pthread_mutex_lock(&lock);
+		while (!sl->done)
+			pthread_cond_wait(&cond, &lock);
+		pthread_mutex_unlock(&lock);
+
+		proutbuf(&sl->ob);
+
+		pthread_mutex_lock(&lock);
+		sl->done = 0;
+		written++;
+		pthread_cond_broadcast(&cond);
+		pthread_mutex_unlock(&lock);
+	}
+
+	for (i = 0;  i < nthreads;  i++)
+		pthread_join(threads[i], NULL);
+	for (i = 0;  i < nslots;  i++) {
+		free(slots[i].ob.buf);
+		free(slots[i].ob.line);
+	}
+	free(slots);
+	free(threads);
+}
+
+static u8 *cdata;        /* First line to dump */
+static size_t clen;      /* Bytes from cdata to end of file */
+static off_t caddr;      /* Address of cdata */
+static size_t clines;    /* Lines in each chunk */
+static size_t nlines;    /* Total number of lines */
+
+/*
+ * Print one chunk of a file.
+ */
+	static void
+dumpchunk(long c)
+{
+	struct dumpstate st;
+	size_t first = c * clines;
+	size_t last = first + clines;
+	size_t ln;
+	int count = dm->count;
+
+	if (last > nlines)
+		last = nlines;
+	/*
+	 * The line before the chunk was collapsed into a "*"
+	 * if it was a duplicate of the line before it.
+	 */
+	st.firstaddr = caddr;
+	st.last_len = count;
+	st.didstar = !dm->verbose && first >= 2 &&
+		eqbuf(cdata + (first-1) * count, cdata + (first-2) * count, count);
+	for (ln = first;  ln < last;  ln++)
+		dumpline(dm, &st, caddr + ln * count, cdata + ln * count, clen - ln * count);
+}
+
+/*
+ * Dump len bytes at data, which start at address addr.
+ * Returns the address after the last line.
+ */
+	off_t
+dumpchunks(u8 *data, size_t len, off_t addr, int nthreads)
+{
+	int count = dm->count;
+
+	cdata = data;
+	clen = len;
+	caddr = addr;
+	nlines = (len + count - 1) / count;
+	clines = CHUNKSIZE / count;
+	if (clines == 0)
+		clines = 1;
+	runjobs((nlines + clines - 1) / clines, dumpchunk, nthreads);
+	return (addr + (off_t) nlines * count);
+}
+
+static struct dumpjob *fjobs;
+static char *foutdir;
+static int fstatus;      /* A file could not be dumped */
+
+	static void
+jobfailed(void)
+{
+	pthread_mutex_lock(&lock);
+	fstatus = -1;
+	pthread_mutex_unlock(&lock);
+}
+
+/*
+ * The name of a file, without its directory.
+ * Its dump in the output directory is named after this.
+ */
+	static char *
+jobbase(char *name)
+{
+	char *base = strrchr(name, '/');
+	return ((base != NULL) ? base+1 : name);
+}
+
+	static int
+cmpbase(const void *a, const void *b)
+{
+	return (strcmp(jobbase(fjobs[*(long *)a].name), jobbase(fjobs[*(long *)b].name)));
+}
+
+/*
+ * Check that no two files of a batch would be dumped
+ * into the same file in the output directory.
+ * Returns -1 if any would.
+ */
+	static int
+checkbases(long n)
+{
+	long *order;
+	long j;
+	int ret = 0;
+
+	if ((order = (long *) malloc(n * sizeof(*order))) == NULL)
+		panic("cannot allocate file list");
+	for (j = 0;  j < n;  j++)
+		order[j] = j;
+	qsort(order, n, sizeof(*order), cmpbase);
+	for (j = 1;  j < n;  j++) {
+		if (cmpbase(&order[j-1], &order[j]) == 0) {
+			fprintf(stderr, "dm: %s and %s would both be dumped to %s/%s.dm\n",
+				fjobs[order[j-1]].name, fjobs[order[j]].name,
+				foutdir, jobbase(fjobs[order[j]].name));
+			ret = -1;
+		}
+	}
+	free(order);
+	return (ret);
+}
+
+/*
+ * Dump one file of a batch.
+ */
+	static void
+dumpjobfile(long j)
+{
+	struct dumpjob *dj = &fjobs[j];
+	struct outbuf fob;
+	struct outbuf *old;
+	char *base;
+	char *path;
+
+	if (foutdir == NULL) {
+		if (dumpfile(dj->name, dj->ranges, dj->nranges, 1) < 0)
+			jobfailed();
+		return;
+	}
+	/*
+	 * Dump into a file named after the input file, in the output directory.
+	 */
+	base = jobbase(dj->name);
+	if ((path = (char *) malloc(strlen(foutdir) + strlen(base) + 5)) == NULL)
+		panic("cannot allocate file name");
+	sprintf(path, "%s/%s.dm", foutdir, base);
+	fob.buf = NULL;
+	fob.len = fob.size = 0;
+	fob.tty = 0;
+	fob.line = NULL;
+	fob.linesize = 0;
+	fob.full = 0;
+	if ((fob.fd = open(path, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0666)) < 0) {
+		fprintf(stderr, "cannot create <%s>\n", path);
+		jobfailed();
+	} else {
+		old = prsetout(&fob);
+		if (dumpfile(dj->name, dj->ranges, dj->nranges, 1) < 0) {
+			/* Don't leave the dump of a missing or broken file. */
+			unlink(path);
+			jobfailed();
+		}
+		prflush();
+		prsetout(old);
+		close(fob.fd);
+		free(fob.buf);
+		free(fob.line);
+	}
+	free(path);
+}
+
+/*
+ * Dump a batch of files with nthreads threads.
+ * If outdir is NULL, the dumps are written to the standard output
+ * in order; otherwise each is written to its own file in outdir.
+ * Returns -1 if any file could not be dumped; nothing is dumped
+ * if two files in outdir would have the same name.
+ */
+	int
+dumpfiles(struct dumpjob *jobs, long n, int nthreads, char *outdir)
+{
+	fjobs = jobs;
+	foutdir = outdir;
+	fstatus = 0;
+	if (outdir != NULL && checkbases(n) < 0)
+		return (-1);
+	runjobs(n, dumpjobfile, nthreads);
+	return (fstatus);
+}
@@ -1,7 +1,7 @@
 #include "dm.h"
 
-struct wchar_range { unsigned long first, last; };
-struct wchar_range_table { struct wchar_range *table; int count; };
+extern const u8 uprop_blocks[][256];
+extern const u16 uprop_index[];
 
 	int
 utf8_size(u8 ch)
@@ -78,68 +78,27 @@ utf8_is_contin(u8 ch)
 	return (ch & 0xC0) == 0x80;
 }
 
-	static int
-is_in_table(unsigned long ch, struct wchar_range_table *table)
+/*
+ * Return the properties (UP_* bits) of a character.
+ * The tables are generated from the *.uni files by mkuprop.
+ */
+	int
+utf8_props(unsigned long ch)
 {
-	/* Binary search in the table. */
-	if (table->table == NULL || table->count == 0 || ch < table->table[0].first)
-		return 0;
-	int lo = 0;
-	int hi = table->count - 1;
-	while (lo <= hi) {
-		int mid = (lo + hi) / 2;
-		if (ch > table->table[mid].last)
-			lo = mid + 1;
-		else if (ch < table->table[mid].first)
-			hi = mid - 1;
-		else
-			return 1;
-	}
-	return 0;
+	if (ch >= 0x110000)
+		/* Not a Unicode character; just print it. */
+		return (UP_PRINT);
+	return (uprop_blocks[uprop_index[ch >> 8]][ch & 0xFF]);
 }
 
-
-#define DECLARE_RANGE_TABLE_START(name) \
-	static struct wchar_range name##_array[] = {
-#define DECLARE_RANGE_TABLE_END(name) \
-	}; struct wchar_range_table name##_table = { name##_array, sizeof(name##_array)/sizeof(*name##_array) };
-
-DECLARE_RANGE_TABLE_START(compose)
-#include "compose.uni"
-DECLARE_RANGE_TABLE_END(compose)
-
-DECLARE_RANGE_TABLE_START(ubin)
-#include "ubin.uni"
-DECLARE_RANGE_TABLE_END(ubin)
-
-DECLARE_RANGE_TABLE_START(wide)
-#include "wide.uni"
-DECLARE_RANGE_TABLE_END(wide)
-
-DECLARE_RANGE_TABLE_START(fmt)
-#include "fmt.uni"
-DECLARE_RANGE_TABLE_END(fmt)
-
-DECLARE_RANGE_TABLE_START(comb)
-	{ 0x0622, 0x0623 },
-	{ 0x0625, 0x0625 },
-	{ 0x0627, 0x0627 },
-	{ 0x0644, 0x0644 },
-DECLARE_RANGE_TABLE_END(comb)
-
 	int
 utf8_is_wide(unsigned long ch)
 {
-	return is_in_table(ch, &wide_table);
+	return ((utf8_props(ch) & UP_WIDE) != 0);
 }
 
 	int
 utf8_is_printable(unsigned long ch)
 {
-	if (ch < 0x20) return 0;
-	return 
-		!is_in_table(ch, &compose_table) &&
-		!is_in_table(ch, &fmt_table) &&
-		!is_in_table(ch, &ubin_table) &&
-		!is_in_table(ch, &comb_table);
+	return ((utf8_props(ch) & UP_PRINT) != 0);
 }